@@ -1,5 +1,6 @@
 // Standard C header files.
 #include <ctime>
+#include <cmath>
 
 // Standard C++ header files.
 #include <string>
@@ -8,13 +9,36 @@
 #include <algorithm>
 #include <deque>
 #include <numeric>
+#include <thread>
+#include <fstream>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
 
 // Windows header files.
+// NOTE: NOMINMAX keeps Windows.h from defining min() and max() macros, which break std::min() and std::max().
+#define NOMINMAX
 #include <Windows.h>
 #include <wincodec.h>
 #include <ShlObj.h>
 #include <Shlwapi.h>
 
+// Custom header files.
+#include "model_snapshot.h"
+#include "multi_window_stats.h"
+#include "mask_morphology.h"
+#include "event_recorder.h"
+#include "kernel_engine.h"
+#include "fast_image_reader.h"
+#include "gray_stream_writer.h"
+#include "synthetic_sequence.h"
+#include "realtime_scheduler.h"
+#include "benchmark_results.h"
+#include "frame_fingerprint.h"
+#include "shared_frame_ring.h"
+#include "frame_memory.h"
+#include "precision_clock.h"
+
 void LoadFileList(std::wstring &pathFolder, std::vector<std::wstring> &filenames)
 {
 	::IFileDialog *file_dialog(nullptr);
@@ -92,6 +116,49 @@ void LoadFileList(std::wstring &pathFolder, std::vector<std::wstring> &filenames
 		::MessageBoxW(nullptr, L"Failed to create a file dialog.", L"Error", MB_OK);
 }
 
+// Convert the first frame of a WIC decoder into a std::vector<byte> where each pixel consists of FOUR continuous elements.
+void DecodeImageFrame(::IWICBitmapDecoder *decoder, std::vector<unsigned char> &dst, ::size_t &width, ::size_t &height, ::IWICImagingFactory *wicFactory)
+{
+	// Get a frame.
+	::IWICBitmapFrameDecode *frame(nullptr);
+	if (SUCCEEDED(decoder->GetFrame(0, &frame)))
+	{
+		// Convert the source image frame to 32bit BGRA.
+		::IWICFormatConverter *format_converter(nullptr);
+		if (SUCCEEDED(wicFactory->CreateFormatConverter(&format_converter)))
+		{
+			if (SUCCEEDED(format_converter->Initialize(frame, ::GUID_WICPixelFormat32bppPBGRA, ::WICBitmapDitherTypeNone,
+				nullptr, 0.0, ::WICBitmapPaletteTypeCustom)))
+			{
+				unsigned int w, h;
+				if (SUCCEEDED(format_converter->GetSize(&w, &h)))
+				{
+					// Set the size with unsigned int instead of ::size_t because ::size_t (== unsigned long) can be wider than unsigned int.
+					unsigned int sz = w * h * 4;
+					if (dst.size() != sz)
+						dst.resize(sz);
+					if (FAILED(format_converter->CopyPixels(nullptr, w * 4, sz, dst.data())))
+						::MessageBoxW(nullptr, L"Failed to copy pixels from the source image frame.", L"Error", MB_OK);
+					width = w;
+					height = h;
+				}
+				else
+					::MessageBoxW(nullptr, L"Failed to get the size of the source image frame.", L"Error", MB_OK);
+			}
+			else
+				::MessageBoxW(nullptr, L"Failed to convert the source image frame.", L"Error", MB_OK);
+
+			format_converter->Release();
+		}
+		else
+			::MessageBoxW(nullptr, L"Failed to create a format converter.", L"Error", MB_OK);
+
+		frame->Release();
+	}
+	else
+		::MessageBoxW(nullptr, L"Failed to get an image frame from a WIC decoder.", L"Error", MB_OK);
+}
+
 // Load an image file into a std::vector<byte> where each pixel consists of FOUR continuous elements.
 // This function interprets all compatible image files in 32bit BGRA.
 void LoadImageFile(const std::wstring &pathSrc, std::vector<unsigned char> &dst, ::size_t &width, ::size_t &height, ::IWICImagingFactory *wicFactory)
@@ -101,49 +168,38 @@ void LoadImageFile(const std::wstring &pathSrc, std::vector<unsigned char> &dst,
 	if (SUCCEEDED(wicFactory->CreateDecoderFromFilename(pathSrc.c_str(), nullptr, GENERIC_READ,
 		::WICDecodeMetadataCacheOnDemand, &decoder)))
 	{
-		// Get a frame.
-		::IWICBitmapFrameDecode *frame(nullptr);
-		if (SUCCEEDED(decoder->GetFrame(0, &frame)))
+		DecodeImageFrame(decoder, dst, width, height, wicFactory);
+		decoder->Release();
+	}
+	else
+		::MessageBoxW(nullptr, L"Failed to create a decoder for a file.", L"Error", MB_OK);
+}
+
+// Same as LoadImageFile() for the contents of an image file which have already been read into memory.
+void LoadImageMemory(const std::vector<unsigned char> &src, std::vector<unsigned char> &dst, ::size_t &width, ::size_t &height, ::IWICImagingFactory *wicFactory)
+{
+	::IWICStream *stream(nullptr);
+	if (SUCCEEDED(wicFactory->CreateStream(&stream)))
+	{
+		// The stream only reads from the buffer.
+		if (SUCCEEDED(stream->InitializeFromMemory(const_cast<BYTE *>(src.data()), static_cast<DWORD>(src.size()))))
 		{
-			// Convert the source image frame to 32bit BGRA.
-			::IWICFormatConverter *format_converter(nullptr);
-			if (SUCCEEDED(wicFactory->CreateFormatConverter(&format_converter)))
+			::IWICBitmapDecoder *decoder(nullptr);
+			if (SUCCEEDED(wicFactory->CreateDecoderFromStream(stream, nullptr, ::WICDecodeMetadataCacheOnDemand, &decoder)))
 			{
-				if (SUCCEEDED(format_converter->Initialize(frame, ::GUID_WICPixelFormat32bppPBGRA, ::WICBitmapDitherTypeNone,
-					nullptr, 0.0, ::WICBitmapPaletteTypeCustom)))
-				{
-					unsigned int w, h;
-					if (SUCCEEDED(format_converter->GetSize(&w, &h)))
-					{
-						// Set the size with unsigned int instead of ::size_t because ::size_t (== unsigned long) can be wider than unsigned int.
-						unsigned int sz = w * h * 4;
-						if (dst.size() != sz)
-							dst.resize(sz);
-						if (FAILED(format_converter->CopyPixels(nullptr, w * 4, sz, dst.data())))
-							::MessageBoxW(nullptr, L"Failed to copy pixels from the source image frame.", L"Error", MB_OK);
-						width = w;
-						height = h;
-					}
-					else
-						::MessageBoxW(nullptr, L"Failed to get the size of the source image frame.", L"Error", MB_OK);
-				}
-				else
-					::MessageBoxW(nullptr, L"Failed to convert the source image frame.", L"Error", MB_OK);
-
-				format_converter->Release();
+				DecodeImageFrame(decoder, dst, width, height, wicFactory);
+				decoder->Release();
 			}
 			else
-				::MessageBoxW(nullptr, L"Failed to create a format converter.", L"Error", MB_OK);
-
-			frame->Release();
+				::MessageBoxW(nullptr, L"Failed to create a decoder for a file.", L"Error", MB_OK);
 		}
 		else
-			::MessageBoxW(nullptr, L"Failed to get an image frame from a WIC decoder.", L"Error", MB_OK);
+			::MessageBoxW(nullptr, L"Failed to initialize a WIC stream from memory.", L"Error", MB_OK);
 
-		decoder->Release();
+		stream->Release();
 	}
 	else
-		::MessageBoxW(nullptr, L"Failed to create a decoder for a file.", L"Error", MB_OK);
+		::MessageBoxW(nullptr, L"Failed to create a WIC stream.", L"Error", MB_OK);
 }
 
 // This function fails for an unknown reason.
@@ -306,9 +362,9 @@ void GrayToBGR(const std::vector<unsigned char> &src, std::vector<unsigned char>
 void ComputeMean(const std::deque<std::vector<float>> &buffer, std::vector<float> &result)
 {
 	// Initialize the output data based on the size of the first vector in the input buffer.
+	// NOTE: The output must be cleared because it is accumulated into, and it still holds the previous frame's result.
 	::size_t sz = buffer.cbegin()->size();
-	if (result.size() != sz)
-		result.resize(sz, 0.0f);
+	result.assign(sz, 0.0f);
 
 	// Accumulate all vectors in the input buffer to the output data.
 	for (const auto &data : buffer)
@@ -346,8 +402,7 @@ void ComputeDiffSq(const std::vector<float> &a, const std::vector<float> &b, std
 void ComputeVar(const std::deque<std::vector<float>> &buffer, const std::vector<float> &mean, std::vector<float> &result)
 {
 	// Initialize the output data based on the size of the mean vector.
-	if (result.size() != mean.size())
-		result.resize(mean.size(), 0.0f);
+	result.assign(mean.size(), 0.0f);
 
 	// Accumulate the squared difference along all vectors in the input buffer.
 	std::vector<float> temp;
@@ -365,8 +420,7 @@ void ComputeVar(const std::deque<std::vector<float>> &buffer, const std::vector<
 void ComputeStd(const std::deque<std::vector<float>> &buffer, const std::vector<float> &mean, std::vector<float> &result)
 {
 	// Initialize the output data based on the size of the mean vector.
-	if (result.size() != mean.size())
-		result.resize(mean.size(), 0.0f);
+	result.assign(mean.size(), 0.0f);
 
 	// Accumulate the squared difference along all vectors in the input buffer.
 	std::vector<float> temp;
@@ -381,18 +435,75 @@ void ComputeStd(const std::deque<std::vector<float>> &buffer, const std::vector<
 	std::for_each(result.begin(), result.end(), [NUM_FRMS](float &value) { value = std::sqrtf(value / NUM_FRMS); });
 }
 
-void Mark(const std::vector<float> &data, const std::vector<float> &mean, const std::vector<float> &std, float th, std::vector<unsigned char> &result)
+// Returns the number of marked (foreground) elements.
+::size_t Mark(const std::vector<float> &data, const std::vector<float> &mean, const std::vector<float> &std, float th, std::vector<unsigned char> &result)
 {
 	// Initialize the output data based on the size of the mean vector.
 	if (result.size() != data.size())
 		result.resize(data.size());
 
 	// Mark elements.
+	::size_t count(0);
 	auto it_data = data.cbegin();
 	auto it_mean = mean.cbegin();
 	auto it_std = std.cbegin();
 	for (auto it_dst = result.begin(), it_end = result.end(); it_dst != it_end; ++it_dst, ++it_data, ++it_mean, ++it_std)
-		*it_dst = (std::abs(*it_data - *it_mean) / *it_std) > th ? 0xFF : 0x00;
+	{
+		bool marked = (std::abs(*it_data - *it_mean) / *it_std) > th;
+		*it_dst = marked ? 0xFF : 0x00;
+		count += marked;
+	}
+	return count;
+}
+
+// Classify the same data against several thresholds in a single pass.
+// 'thresholds' must be sorted in ascending order. Each pixel's normalized distance is computed once and
+// located among the thresholds, so the cost grows with log(thresholds.size()) instead of thresholds.size().
+// histogram[k] is incremented for every pixel above exactly the first k thresholds; HistogramToCounts()
+// turns it into per-threshold foreground counts. If groundTruth is not empty, histogramTruePositive
+// does the same for pixels which are non-zero in groundTruth. If masks is not null, (*masks)[i] receives
+// the same mask as Mark(data, mean, std, thresholds[i]).
+void MarkMulti(const std::vector<float> &data, const std::vector<float> &mean, const std::vector<float> &std,
+	const std::vector<float> &thresholds, const std::vector<unsigned char> &groundTruth,
+	std::vector<::size_t> &histogram, std::vector<::size_t> &histogramTruePositive, std::vector<std::vector<unsigned char>> *masks)
+{
+	const ::size_t NUM_TH = thresholds.size();
+	if (histogram.size() != NUM_TH + 1)
+		histogram.resize(NUM_TH + 1, 0);
+	if (histogramTruePositive.size() != NUM_TH + 1)
+		histogramTruePositive.resize(NUM_TH + 1, 0);
+	if (masks != nullptr)
+	{
+		masks->resize(NUM_TH);
+		for (auto &mask : *masks)
+			mask.resize(data.size());
+	}
+	const bool has_truth = groundTruth.size() == data.size();
+
+	for (::size_t n = 0, sz = data.size(); n != sz; ++n)
+	{
+		// Same expression as Mark(), so NaN (0 / 0) is never foreground and inf is always foreground.
+		float value = std::abs(data[n] - mean[n]) / std[n];
+		::size_t k = std::lower_bound(thresholds.cbegin(), thresholds.cend(), value) - thresholds.cbegin();
+		++histogram[k];
+		if (has_truth && groundTruth[n] != 0)
+			++histogramTruePositive[k];
+		if (masks != nullptr)
+			for (::size_t i = 0; i != NUM_TH; ++i)
+				(*masks)[i][n] = i < k ? 0xFF : 0x00;
+	}
+}
+
+// Convert a histogram from MarkMulti() into the number of pixels above each threshold.
+void HistogramToCounts(const std::vector<::size_t> &histogram, std::vector<::size_t> &counts)
+{
+	counts.assign(histogram.size() - 1, 0);
+	::size_t sum(0);
+	for (::size_t k = histogram.size() - 1; k != 0; --k)
+	{
+		sum += histogram[k];
+		counts[k - 1] = sum;
+	}
 }
 
 // Load image files, and do nothing else.
@@ -417,15 +528,623 @@ void Test0(::IWICImagingFactory *wicFactory, const std::wstring &pathFolder, con
 	}
 }
 
+// Options for Test1().
+struct Test1Options
+{
+	::size_t MaxBufferLength = 5;
+	float Threshold = 3.5f;
+
+	// Path of a background model snapshot. If the file exists and was written for the same folder, the buffer is
+	// restored from it and processing continues after the last file the snapshot consumed, so an interrupted run
+	// resumes without waiting for a full window. A snapshot of a completed run starts over with an empty buffer.
+	// Leave empty to always start with an empty buffer.
+	std::wstring PathSnapshot;
+	::size_t SnapshotInterval = 0;	// Write a snapshot every N frames. 0 writes only at the end.
+
+	// Square kernel sizes for cleaning up the mask right after Mark(). 0 or 1 skips the step.
+	::size_t OpenKernelSize = 0;	// Removes speckles.
+	::size_t CloseKernelSize = 0;	// Fills holes; applied after opening.
+
+	// Event-triggered output. Only frames with at least ActivityThreshold foreground pixels are written,
+	// together with up to PreRoll frames before and PostRoll frames after them. 0 writes every frame.
+	::size_t ActivityThreshold = 0;
+	::size_t PreRoll = 0, PostRoll = 0;
+
+	// Use the SIMD kernels selected by CPUID for gray conversion, statistics, Mark() and GrayToBGR() instead of
+	// the reference functions. The results are identical.
+	bool UseKernels = true;
+	// Time candidate tile sizes and thread counts once the buffer is full for the first time and keep the fastest.
+	// Otherwise the frame is split as configured in Tiles, which defaults to the whole frame on one thread.
+	// Test1RealTime() always uses Tiles.
+	bool AutoTune = true;
+	TileConfig Tiles;
+
+	// Read uncompressed BMP, PGM and PPM files with the native gray reader instead of WIC.
+	bool UseFastReader = true;
+
+	// Folder of the per-frame <file>_.bmp masks. Empty writes them into the working directory.
+	std::wstring PathOutput;
+
+	// Append the masks to one Y4M or raw gray stream at PathStream instead of writing one BMP per frame.
+	bool WriteStream = false;
+	StreamFormat Format = StreamFormat::Y4M;
+	std::wstring PathStream = L"masks.y4m";
+
+	// Frames from a frozen camera are not processed again and not added to the buffer; the previous mask is written
+	// for them instead. A file identical to the previous one is found by a fingerprint of its bytes before it is
+	// decoded, and a frame which decodes to the newest buffered frame by comparing the two.
+	// If NearDuplicateThreshold is above 0, so are frames whose mean absolute gray difference to the newest buffered
+	// frame is below it in every 16x16 tile (see IsNearDuplicate()).
+	// Off by default: skipped frames never enter the buffer, so the masks differ from Test1Chunked() and the other
+	// variants, which classify every frame.
+	bool SkipDuplicates = false;
+	float NearDuplicateThreshold = 0.0f;	// 0 skips only identical frames.
+
+	// Publish the gray image, mask and metadata of every frame into the shared memory ring of this name, for trackers
+	// running as separate processes (see ConsumeSharedFrames()). The ring is sized for the first frame. Empty disables it.
+	std::wstring SharedRingName;
+
+	// Keep the frames and model planes of Test1() in one FrameHistory allocation, backed by huge pages where the system
+	// allows it, instead of one std::vector per frame. Only with UseKernels.
+	bool HugePageHistory = false;
+
+	// Seconds from the arrival of a frame to its mask in Test1RealTime(). Beyond it, load is shed.
+	double LatencyBudget = 0.1;
+};
+
+// Path of the BMP mask of 'filename' in options.PathOutput.
+std::wstring MaskPath(const Test1Options &options, const std::wstring &filename)
+{
+	std::wstring path_dst = options.PathOutput.empty() ? L"" : options.PathOutput + L"\\";
+	return path_dst + ::PathFindFileNameW(filename.c_str()) + L"_.bmp";
+}
+
+// Apply the morphological cleanup configured in options to a mask in place.
+// Returns the number of foreground pixels after the cleanup; numForeground is the count before it.
+::size_t CleanUpMask(MaskMorphology &morphology, std::vector<unsigned char> &mask, ::size_t width, ::size_t height,
+	const Test1Options &options, ::size_t numForeground)
+{
+	if (options.OpenKernelSize <= 1 && options.CloseKernelSize <= 1)
+		return numForeground;
+	if (options.OpenKernelSize > 1)
+		morphology.Open(mask, mask, width, height, options.OpenKernelSize, options.OpenKernelSize);
+	if (options.CloseKernelSize > 1)
+		morphology.Close(mask, mask, width, height, options.CloseKernelSize, options.CloseKernelSize);
+	return static_cast<::size_t>(std::count(mask.cbegin(), mask.cend(), 0xFF));
+}
+
 // 
-void Test1(::IWICImagingFactory *wicFactory, const std::wstring &pathFolder, const std::vector<std::wstring> &filenames)
+void Test1(::IWICImagingFactory *wicFactory, const std::wstring &pathFolder, const std::vector<std::wstring> &filenames, const Test1Options &options)
+{
+	const ::size_t MAX_BUFFER_LENGTH(options.MaxBufferLength);
+	std::deque<std::vector<float>> buffer;
+	::size_t width(0), height(0), frame_count(0);
+	std::vector<unsigned char> file_data, src_data, dst;
+	std::vector<float> avg, std;
+	std::vector<unsigned char> out_temp;
+	MaskMorphology morphology;
+	const PixelKernels &kernels = SelectPixelKernels();
+	TileConfig tile_config = options.Tiles;
+	std::unique_ptr<WorkerPool> pool;
+	// The first core of the list is this thread's (see TileConfig::Cores). It stays pinned after Test1() returns.
+	if (!options.Tiles.Cores.empty() && !PinCurrentThread(options.Tiles.Cores[0]))
+		std::wclog << L"Failed to pin the calling thread to core " << options.Tiles.Cores[0] << std::endl;
+	bool tuned = !options.UseKernels || !options.AutoTune;
+	// With HugePageHistory, frames go into 'history' instead of 'buffer' once the frame size is known.
+	bool use_history = options.HugePageHistory && options.UseKernels;
+	FrameHistory history;
+	const float *newest(nullptr);	// Newest buffered frame.
+	GrayStreamWriter stream;
+	EventRecorder recorder(options.ActivityThreshold, options.PreRoll, options.PostRoll,
+		[&](const std::wstring &pathDst, const std::vector<unsigned char> &mask)
+	{
+		if (options.WriteStream)
+		{
+			// The stream is created on the first written frame, when the resolution is known.
+			if (!stream.IsOpen())
+				stream.Open(options.PathStream, options.Format, width, height);
+			stream.WriteFrame(mask.data(), mask.size());
+			return;
+		}
+		if (options.UseKernels)
+		{
+			out_temp.resize(mask.size() * 3);
+			kernels.GrayToBgr(mask.data(), out_temp.data(), mask.size());
+		}
+		else
+			GrayToBGR(mask, out_temp);
+		SaveImageFile(pathDst, out_temp, static_cast<unsigned int>(width), static_cast<unsigned int>(height), wicFactory);
+	});
+
+	// Warm start from the last snapshot if there is one, continuing with the file after the last one it consumed.
+	// Restoring the window in front of any other frame would classify it against an unrelated part of the sequence.
+	::size_t first(0);
+	std::wstring last_file;
+	if (!options.PathSnapshot.empty() &&
+		LoadModelSnapshot(options.PathSnapshot, pathFolder, buffer, last_file, width, height, frame_count, MAX_BUFFER_LENGTH))
+	{
+		auto it = std::find(filenames.cbegin(), filenames.cend(), last_file);
+		if (it == filenames.cend() || it + 1 == filenames.cend())
+		{
+			std::wclog << L"Snapshot " << options.PathSnapshot << (it == filenames.cend() ?
+				L" stopped at a file which is not in the folder" : L" is from a completed run") << L"; starting with an empty buffer." << std::endl;
+			buffer.clear();
+			frame_count = 0;
+			last_file.clear();
+		}
+		else
+		{
+			first = static_cast<::size_t>(it - filenames.cbegin()) + 1;
+			std::wclog << L"Restored " << buffer.size() << L" frames from " << options.PathSnapshot << L"; resuming at frame "
+				<< frame_count << L" (" << filenames[first] << L")" << std::endl;
+		}
+	}
+
+	auto save_snapshot = [&]()
+	{
+		if (!use_history || history.Size() == 0)
+		{
+			SaveModelSnapshot(options.PathSnapshot, pathFolder, buffer, last_file, width, height, frame_count, MAX_BUFFER_LENGTH);
+			return;
+		}
+		std::deque<std::vector<float>> frames;
+		for (auto frame : history.Frames())
+			frames.push_back(std::vector<float>(frame, frame + history.FrameSize()));
+		SaveModelSnapshot(options.PathSnapshot, pathFolder, frames, last_file, width, height, frame_count, MAX_BUFFER_LENGTH);
+	};
+
+	std::vector<float> spare;	// Memory of the last frame which left the buffer or was skipped.
+	unsigned long long last_fingerprint(0);
+	bool has_fingerprint(false);
+	::size_t num_foreground(0), num_exact_duplicates(0), num_near_duplicates(0);
+	SharedFrameRing ring;
+	bool ring_failed(false);
+	::size_t num_unpublished(0);
+	// Write the current mask for frame n; skipped frames repeat the previous gray image and mask.
+	auto write_output = [&](const std::wstring &pathDst, ::size_t n)
+	{
+		recorder.Push(pathDst, dst, num_foreground);
+		if (options.SharedRingName.empty() || ring_failed)
+			return;
+		if (!ring.IsOpen() && !ring.Create(options.SharedRingName, width, height))
+		{
+			std::wclog << L"Failed to create a shared memory ring " << options.SharedRingName << L"; no frames are published." << std::endl;
+			ring_failed = true;
+			return;
+		}
+		// Consumers keep the mapping they opened, so the ring is not recreated for larger frames; they are left out.
+		if (!ring.Publish(n, newest, dst.data(), width, height, num_foreground) && num_unpublished++ == 0)
+			std::wclog << L"Frame " << n << L" (" << width << L"x" << height << L") doesn't fit the shared memory ring "
+				<< options.SharedRingName << L"; larger frames are not published." << std::endl;
+	};
+	// Snapshots are taken between input files, skipped ones included, so a resumed run continues exactly where it stopped.
+	auto finish_frame = [&](const std::wstring &pathDst, ::size_t n)
+	{
+		write_output(pathDst, n);
+		if (!options.PathSnapshot.empty() && options.SnapshotInterval != 0 && frame_count % options.SnapshotInterval == 0)
+			save_snapshot();
+	};
+	for (::size_t n = first; n != filenames.size(); ++n)
+	{
+		const auto &filename = filenames[n];
+		last_file = filename;
+		++frame_count;
+		std::wstring path_src = pathFolder + L"\\" + filename;
+		std::wstring path_dst = MaskPath(options, filename);
+
+		// Read the file once. A frozen camera repeats the same file, which gives the same mask again; it is found by
+		// its bytes before anything is decoded.
+		const bool has_file_data = ReadBinaryFile(path_src, file_data);
+		if (options.SkipDuplicates && has_file_data)
+		{
+			const unsigned long long fingerprint = FingerprintBytes(file_data.data(), file_data.size());
+			const bool exact = has_fingerprint && fingerprint == last_fingerprint;
+			last_fingerprint = fingerprint;
+			has_fingerprint = true;
+			if (exact && !dst.empty())
+			{
+				++num_exact_duplicates;
+				finish_frame(path_dst, n);
+				continue;
+			}
+		}
+
+		// Decode the file from memory. Uncompressed formats are converted straight into the gray frame.
+		std::vector<float> data(std::move(spare));
+		if (!options.UseFastReader || !has_file_data || !DecodeGrayImageFast(file_data.data(), file_data.size(), data, width, height))
+		{
+			if (has_file_data)
+				LoadImageMemory(file_data, src_data, width, height, wicFactory);
+			else
+				LoadImageFile(path_src, src_data, width, height, wicFactory);
+			if (options.UseKernels)
+			{
+				data.resize(src_data.size() / 4);
+				kernels.BgraToGray(src_data.data(), data.data(), data.size());
+			}
+			else
+				BGRAtoGray_(src_data, data);
+		}
+
+		// Discard the buffered frames if the resolution has changed, e.g. a snapshot from another camera.
+		if (!buffer.empty() && buffer.back().size() != data.size())
+			buffer.clear();
+		if (use_history && history.FrameSize() != data.size())
+		{
+			// Frames restored from a snapshot move into the history.
+			if (history.Allocate(data.size(), MAX_BUFFER_LENGTH, true))
+			{
+				std::wclog << L"Frame history in " << PageKindName(history.Kind()) << std::endl;
+				for (const auto &frame : buffer)
+				{
+					std::copy(frame.cbegin(), frame.cend(), history.Reserve());
+					history.Push();
+				}
+				buffer.clear();
+			}
+			else
+			{
+				std::wclog << L"Failed to allocate the frame history; using one vector per frame." << std::endl;
+				use_history = false;
+			}
+		}
+		if (use_history)
+			newest = history.Size() != 0 ? history.Frames().back() : nullptr;
+		else
+			newest = buffer.empty() ? nullptr : buffer.back().data();
+
+		// A file which differs but decodes to the newest buffered frame gives the same mask again, and a frame which
+		// hardly differs from it would only distort the statistics.
+		if (options.SkipDuplicates && newest != nullptr && !dst.empty())
+		{
+			const bool exact = std::memcmp(data.data(), newest, data.size() * sizeof(float)) == 0;
+			if (exact || (options.NearDuplicateThreshold > 0.0f &&
+				IsNearDuplicate(data.data(), newest, width, height, options.NearDuplicateThreshold)))
+			{
+				++(exact ? num_exact_duplicates : num_near_duplicates);
+				spare = std::move(data);
+				finish_frame(path_dst, n);
+				continue;
+			}
+		}
+
+		// Push the data to a buffer, reusing the memory of the frame which leaves it.
+		if (use_history)
+		{
+			std::copy(data.cbegin(), data.cend(), history.Reserve());
+			history.Push();
+			spare = std::move(data);
+			newest = history.Frames().back();
+		}
+		else
+		{
+			if (buffer.size() == MAX_BUFFER_LENGTH)
+			{
+				spare = std::move(buffer.front());
+				buffer.pop_front();
+			}
+			buffer.push_back(std::move(data));
+			newest = buffer.back().data();
+		}
+
+		// Do something.
+		if (options.UseKernels)
+		{
+			if (!tuned && (use_history ? history.Size() : buffer.size()) == MAX_BUFFER_LENGTH)
+			{
+				tile_config = use_history ? AutoTuneTiles(kernels, history.Frames(), history.FrameSize(), options.Threshold) :
+					AutoTuneTiles(kernels, buffer, options.Threshold);
+				tuned = true;
+				std::wclog << kernels.Name << L" kernels, tile size " << tile_config.TileSize << L", "
+					<< tile_config.NumThreads << L" threads" << std::endl;
+			}
+			AttachWorkerPool(tile_config, pool, options.Tiles.Cores);
+			if (use_history)
+			{
+				num_foreground = ComputeModelTiled(kernels, tile_config, history.Frames(), history.FrameSize(), options.Threshold,
+					history.Mean(), history.Std(), history.Mask());
+				dst.assign(history.Mask(), history.Mask() + history.FrameSize());
+			}
+			else
+				num_foreground = ComputeModelTiled(kernels, tile_config, buffer, options.Threshold, avg, std, dst);
+		}
+		else
+		{
+			ComputeMean(buffer, avg);
+			ComputeStd(buffer, avg, std);
+			num_foreground = Mark(buffer.back(), avg, std, options.Threshold, dst);
+		}
+		num_foreground = CleanUpMask(morphology, dst, width, height, options, num_foreground);
+
+		// Export output, unless the event policy decides the frame is not worth writing.
+		// TODO: Something is not right.
+		finish_frame(path_dst, n);
+	}
+
+	if (!options.PathSnapshot.empty() && (!buffer.empty() || history.Size() != 0))
+		save_snapshot();
+
+	if (num_unpublished != 0)
+		std::wclog << num_unpublished << L" frames were too large for the shared memory ring." << std::endl;
+	if (num_exact_duplicates != 0 || num_near_duplicates != 0)
+		std::wclog << num_exact_duplicates << L" identical and " << num_near_duplicates << L" nearly identical frames skipped."
+			<< std::endl;
+	if (options.ActivityThreshold != 0)
+		std::wclog << recorder.NumEvents() << L" events, " << recorder.NumWritten() << L" frames written, "
+			<< recorder.NumSkipped() << L" frames skipped." << std::endl;
+}
+
+// Statistics of a chunk processed by Test1Chunked().
+struct ChunkReport
+{
+	::size_t Begin = 0, End = 0;	// Frames [Begin, End) classified by the chunk.
+	::size_t WarmUp = 0;			// Frames loaded ahead of Begin only to fill the buffer.
+	double Seconds = 0.0;
+};
+
+// Process filenames[begin, end) with an independent model as one chunk of Test1Chunked().
+// The chunk pre-rolls the MAX_BUFFER_LENGTH - 1 frames preceding 'begin' into its buffer without
+// classifying them, so every frame sees exactly the same window as in a sequential Test1() run.
+// Runs on its own thread, so it initializes COM and creates its own WIC factory.
+void ProcessChunk(const std::wstring &pathFolder, const std::vector<std::wstring> &filenames, ::size_t begin, ::size_t end,
+	const Test1Options &options, std::vector<::size_t> &counts, ChunkReport &report)
 {
-	const ::size_t MAX_BUFFER_LENGTH(5);
+	::clock_t t_start = ::clock();
+	// A buffer needs at least one frame; 0 would also underflow the pre-roll length.
+	const ::size_t MAX_BUFFER_LENGTH(std::max<::size_t>(1, options.MaxBufferLength));
+	const ::size_t warm_up = std::min(begin, MAX_BUFFER_LENGTH - 1);
+	report.Begin = begin;
+	report.End = end;
+	report.WarmUp = warm_up;
+
+	if (SUCCEEDED(::CoInitializeEx(nullptr, ::COINIT_MULTITHREADED | ::COINIT_DISABLE_OLE1DDE)))
+	{
+		::IWICImagingFactory *wic_factory(nullptr);
+		if (SUCCEEDED(::CoCreateInstance(::CLSID_WICImagingFactory, nullptr, CLSCTX_ALL, IID_PPV_ARGS(&wic_factory))))
+		{
+			std::deque<std::vector<float>> buffer;
+			::size_t width(0), height(0);
+			std::vector<unsigned char> src_data, dst;
+			std::vector<float> avg, std;
+			std::vector<unsigned char> out_temp;
+			MaskMorphology morphology;
+			for (::size_t n = begin - warm_up; n != end; ++n)
+			{
+				// Load an image file.
+				std::wstring path_src = pathFolder + L"\\" + filenames[n];
+				LoadImageFile(path_src, src_data, width, height, wic_factory);
+				std::vector<float> data;
+				BGRAtoGray_(src_data, data);
+
+				// Push the data to a buffer.
+				if (!buffer.empty() && buffer.back().size() != data.size())
+					buffer.clear();
+				if (buffer.size() == MAX_BUFFER_LENGTH)
+					buffer.pop_front();
+				buffer.push_back(std::move(data));
+
+				// Warm-up frames only fill the buffer.
+				if (n < begin)
+					continue;
+
+				ComputeMean(buffer, avg);
+				ComputeStd(buffer, avg, std);
+				::size_t num_foreground = Mark(buffer.back(), avg, std, options.Threshold, dst);
+				counts[n] = CleanUpMask(morphology, dst, width, height, options, num_foreground);
+
+				// Export output.
+				GrayToBGR(dst, out_temp);
+				SaveImageFile(MaskPath(options, filenames[n]), out_temp, static_cast<unsigned int>(width), static_cast<unsigned int>(height), wic_factory);
+			}
+
+			wic_factory->Release();
+		}
+		else
+			std::wclog << L"Failed to instantiate a WIC factory for frames " << begin << L" - " << end << std::endl;
+
+		::CoUninitialize();
+	}
+	else
+		std::wclog << L"Failed to initialize COM for frames " << begin << L" - " << end << std::endl;
+
+	report.Seconds = static_cast<double>(::clock() - t_start) / CLOCKS_PER_SEC;
+}
+
+// Same output as Test1(), but splits the sorted frame list into contiguous chunks and processes them concurrently.
+// Intended for offline backfills; snapshots are ignored because every chunk starts from its own pre-roll,
+// and every frame is written because the event policy of one chunk would depend on the end of the previous one.
+// 'counts' receives the number of foreground pixels of every frame in the original order.
+void Test1Chunked(const std::wstring &pathFolder, const std::vector<std::wstring> &filenames, const Test1Options &options,
+	::size_t numChunks, std::vector<::size_t> &counts)
+{
+	counts.assign(filenames.size(), 0);
+	if (filenames.empty())
+		return;
+
+	// Don't make chunks shorter than the buffer, otherwise the pre-roll costs more than the chunk itself.
+	if (numChunks == 0)
+		numChunks = std::max(1u, std::thread::hardware_concurrency());
+	numChunks = std::max<::size_t>(1, std::min(numChunks, filenames.size() / std::max<::size_t>(1, options.MaxBufferLength)));
+
+	std::vector<ChunkReport> reports(numChunks);
+	std::vector<std::thread> workers;
+	const ::size_t sz_chunk = (filenames.size() + numChunks - 1) / numChunks;
+	for (::size_t n = 0; n != numChunks; ++n)
+	{
+		::size_t begin = std::min(n * sz_chunk, filenames.size());
+		::size_t end = std::min(begin + sz_chunk, filenames.size());
+		workers.push_back(std::thread(ProcessChunk, std::cref(pathFolder), std::cref(filenames), begin, end,
+			std::cref(options), std::ref(counts), std::ref(reports[n])));
+	}
+	for (auto &worker : workers)
+		worker.join();
+
+	// Report the throughput of each chunk in order.
+	for (::size_t n = 0; n != numChunks; ++n)
+	{
+		const auto &report = reports[n];
+		::size_t num_frms = report.End - report.Begin;
+		std::wclog << L"Chunk " << n << L": frames " << report.Begin << L" - " << report.End
+			<< L" (+" << report.WarmUp << L" warm-up), " << report.Seconds << L" (sec), "
+			<< (report.Seconds > 0.0 ? num_frms / report.Seconds : 0.0) << L" (fps)" << std::endl;
+	}
+}
+
+// Simulated live source: pushes 'numFrames' synthetic frames into 'queue' at 'sourceFps' frames per second, stamped
+// on arrival, and closes the queue. Generating a frame can take longer than its period, so 'numDistinct' frames are
+// generated in advance and replayed.
+void ReplaySyntheticSource(FrameQueue &queue, const SyntheticConfig &source, double sourceFps, ::size_t numFrames, ::size_t numDistinct)
+{
+	std::vector<std::vector<float>> frames(std::max<::size_t>(1, std::min(numFrames, numDistinct)));
+	SyntheticSequence sequence(source);
+	for (auto &frame : frames)
+		sequence.Next(frame);
+
+	auto t_start = RealTimeClock::now();
+	for (::size_t n = 0; n != numFrames; ++n)
+	{
+		std::this_thread::sleep_until(t_start + std::chrono::duration_cast<RealTimeClock::duration>(
+			std::chrono::duration<double>(n / sourceFps)));
+		TimedFrame frame;
+		frame.Data = frames[n % frames.size()];
+		frame.Index = n;
+		frame.Arrival = RealTimeClock::now();
+		queue.Push(std::move(frame));
+	}
+	queue.Close();
+}
+
+// Real-time variant of Test1() for a live source of width x height frames, which another thread pushes into 'queue'
+// and closes when it ends; the calling thread classifies them. When the oldest queued frame gets older than the
+// latency budget, load is shed in stages (see LoadShedder): frames are classified against the last model without
+// updating it, then at half resolution, and finally every queued frame but the newest is skipped. A stale mask is
+// worth nothing for a live feed.
+// Every decision is written to realtime_metrics.csv and summed in 'metrics'. Masks go to the stream of options if
+// WriteStream is set; snapshots and the event policy don't apply. options.Tiles is used as given: AutoTuneTiles()
+// times every candidate on the buffer and would stall the feed far beyond the budget.
+void Test1RealTime(FrameQueue &queue, ::size_t width, ::size_t height, const Test1Options &options, RealTimeMetrics &metrics)
+{
+	metrics = RealTimeMetrics();
+	const ::size_t MAX_BUFFER_LENGTH(options.MaxBufferLength);
+	const PixelKernels &kernels = SelectPixelKernels();
+
+	LoadShedder shedder(options.LatencyBudget);
+	std::deque<std::vector<float>> buffer;
+	std::vector<float> avg, std, half_data, half_avg, half_std;
+	std::vector<unsigned char> dst, half_dst;
+	bool half_valid(false);		// half_avg and half_std are up to date with avg and std.
+	MaskMorphology morphology;
+	TileConfig tile_config = options.Tiles;
+	std::unique_ptr<WorkerPool> pool;
+	// As in Test1(), the first core of the list is this thread's.
+	if (!options.Tiles.Cores.empty() && !PinCurrentThread(options.Tiles.Cores[0]))
+		std::wclog << L"Failed to pin the calling thread to core " << options.Tiles.Cores[0] << std::endl;
+	GrayStreamWriter stream;
+	if (options.WriteStream)
+		stream.Open(options.PathStream, options.Format, width, height);
+
+	std::wofstream csv("realtime_metrics.csv");
+	csv << L"frame,stage,queued,queue_age_ms,dropped,latency_ms,foreground" << std::endl;
+	TimedFrame frame;
+	while (queue.Pop(frame))
+	{
+		++metrics.NumArrived;
+
+		// The frame just taken is the oldest one, so its age decides the stage.
+		::size_t num_queued = queue.Size();
+		double queue_age = std::chrono::duration<double>(RealTimeClock::now() - frame.Arrival).count();
+		ShedStage stage = shedder.Decide(queue_age);
+
+		// Skip this frame and everything behind it but the newest one.
+		if (stage == ShedStage::DropFrames && num_queued != 0)
+		{
+			::size_t num_dropped = queue.DropAllButNewest() + 1;
+			metrics.NumArrived += num_dropped - 1;
+			metrics.NumDropped += num_dropped;
+			csv << frame.Index << L"," << ShedStageName(stage) << L"," << num_queued << L"," << queue_age * 1000.0 << L","
+				<< num_dropped << L",," << std::endl;
+			continue;
+		}
+		// Nothing left to drop; classify the frame as cheaply as possible.
+		if (stage == ShedStage::DropFrames)
+			stage = ShedStage::ReducedResolution;
+		// Without a model there is nothing to classify against, and half resolution needs at least 2x2 pixels.
+		if (avg.size() != frame.Data.size())
+			stage = ShedStage::None;
+		if (stage == ShedStage::ReducedResolution && (width < 2 || height < 2))
+			stage = ShedStage::SkipModelUpdate;
+
+		::size_t num_foreground(0);
+		if (stage == ShedStage::None)
+		{
+			if (buffer.size() == MAX_BUFFER_LENGTH)
+				buffer.pop_front();
+			buffer.push_back(std::move(frame.Data));
+			AttachWorkerPool(tile_config, pool, options.Tiles.Cores);
+			num_foreground = ComputeModelTiled(kernels, tile_config, buffer, options.Threshold, avg, std, dst);
+			half_valid = false;
+		}
+		else if (stage == ShedStage::SkipModelUpdate)
+			num_foreground = kernels.Mark(frame.Data.data(), avg.data(), std.data(), options.Threshold, dst.data(), dst.size());
+		else
+		{
+			if (!half_valid)
+			{
+				DownsampleHalf(avg.data(), width, height, half_avg);
+				DownsampleHalf(std.data(), width, height, half_std);
+				half_dst.resize(half_avg.size());
+				half_valid = true;
+			}
+			DownsampleHalf(frame.Data.data(), width, height, half_data);
+			kernels.Mark(half_data.data(), half_avg.data(), half_std.data(), options.Threshold, half_dst.data(), half_dst.size());
+			UpsampleHalf(half_dst, width, height, dst);
+			num_foreground = static_cast<::size_t>(std::count(dst.cbegin(), dst.cend(), 0xFF));
+		}
+		num_foreground = CleanUpMask(morphology, dst, width, height, options, num_foreground);
+		if (stream.IsOpen())
+			stream.WriteFrame(dst.data(), dst.size());
+
+		double latency = std::chrono::duration<double>(RealTimeClock::now() - frame.Arrival).count();
+		++metrics.NumProcessed[static_cast<int>(stage)];
+		metrics.SumLatency += latency;
+		metrics.MaxLatency = std::max(metrics.MaxLatency, latency);
+		if (latency > options.LatencyBudget)
+			++metrics.NumOverBudget;
+		csv << frame.Index << L"," << ShedStageName(stage) << L"," << num_queued << L"," << queue_age * 1000.0 << L",0,"
+			<< latency * 1000.0 << L"," << num_foreground << std::endl;
+	}
+	metrics.NumStageChanges = shedder.NumStageChanges();
+
+	::size_t num_processed = metrics.NumArrived - metrics.NumDropped;
+	std::wclog << L"Real-time: " << metrics.NumArrived << L" frames, budget "
+		<< options.LatencyBudget * 1000.0 << L" (ms), " << metrics.NumStageChanges << L" stage changes" << std::endl;
+	for (int n = 0; n != 3; ++n)
+		std::wclog << L"  " << ShedStageName(static_cast<ShedStage>(n)) << L": " << metrics.NumProcessed[n] << L" frames" << std::endl;
+	std::wclog << L"  dropped: " << metrics.NumDropped << L" frames" << std::endl;
+	std::wclog << L"  latency: mean " << (num_processed != 0 ? metrics.SumLatency / num_processed * 1000.0 : 0.0)
+		<< L" (ms), max " << metrics.MaxLatency * 1000.0 << L" (ms), " << metrics.NumOverBudget << L" frames over budget" << std::endl;
+}
+
+// Run the Test1() model once per frame and classify it against every value in 'thresholds'.
+// Per-threshold foreground counts are written to threshold_sweep.csv. If pathGroundTruth is not empty,
+// it holds a mask with the same filename for each frame (non-zero = foreground), and precision and
+// recall are reported for every threshold over the frames which have one. Masks are saved as
+// <file>_<threshold>.bmp only if saveMasks is set.
+void Test1Sweep(::IWICImagingFactory *wicFactory, const std::wstring &pathFolder, const std::vector<std::wstring> &filenames,
+	const Test1Options &options, std::vector<float> thresholds, const std::wstring &pathGroundTruth, bool saveMasks)
+{
+	std::sort(thresholds.begin(), thresholds.end());
+	const ::size_t MAX_BUFFER_LENGTH(options.MaxBufferLength);
 	std::deque<std::vector<float>> buffer;
 	::size_t width, height;
-	std::vector<unsigned char> src_data, dst;
+	std::vector<unsigned char> src_data, gt_data, ground_truth, row;
 	std::vector<float> avg, std;
 	std::vector<unsigned char> out_temp;
+	// histogram counts every frame; histogram_truth and histogram_tp only frames with a ground truth mask,
+	// so precision and recall are not diluted by frames which can't be scored.
+	std::vector<::size_t> histogram, histogram_truth, histogram_tp, histogram_frame;
+	std::vector<std::vector<unsigned char>> masks;
+	::size_t num_truth(0), num_truth_frames(0);
 	for (const auto &filename : filenames)
 	{
 		// Load an image file.
@@ -435,23 +1154,776 @@ void Test1(::IWICImagingFactory *wicFactory, const std::wstring &pathFolder, con
 		BGRAtoGray_(src_data, data);
 
 		// Push the data to a buffer.
+		if (!buffer.empty() && buffer.back().size() != data.size())
+			buffer.clear();
 		if (buffer.size() == MAX_BUFFER_LENGTH)
 			buffer.pop_front();
 		buffer.push_back(std::move(data));
 
-		// Do something.
+		// Load the ground truth mask by taking the blue channel as BGRAtoGray_() does. A frame without a readable
+		// mask of the same size is classified but not scored.
+		ground_truth.clear();
+		if (!pathGroundTruth.empty())
+		{
+			std::wstring path_gt = pathGroundTruth + L"\\" + filename;
+			::size_t gt_width(0), gt_height(0);
+			if (!LoadGrayImageFast(path_gt, ground_truth, gt_width, gt_height, row))
+			{
+				// Formats the fast reader doesn't handle go through WIC, which would complain about a missing file.
+				ground_truth.clear();
+				gt_data.clear();
+				if (::PathFileExistsW(path_gt.c_str()))
+					LoadImageFile(path_gt, gt_data, gt_width, gt_height, wicFactory);
+				if (!gt_data.empty() && gt_data.size() == gt_width * gt_height * 4)
+				{
+					ground_truth.resize(gt_width * gt_height);
+					for (::size_t n = 0; n != ground_truth.size(); ++n)
+						ground_truth[n] = gt_data[n * 4];
+				}
+			}
+			if (ground_truth.empty())
+				std::wclog << L"Skipping ground truth for " << filename << L" because it can't be read." << std::endl;
+			else if (gt_width != width || gt_height != height)
+			{
+				std::wclog << L"Skipping ground truth for " << filename << L" due to size mismatch." << std::endl;
+				ground_truth.clear();
+			}
+			else
+			{
+				num_truth += ground_truth.size() - std::count(ground_truth.cbegin(), ground_truth.cend(), 0);
+				++num_truth_frames;
+			}
+		}
+
+		// Compute the model once and classify against all thresholds.
 		ComputeMean(buffer, avg);
 		ComputeStd(buffer, avg, std);
-		Mark(buffer.back(), avg, std, 3.5f, dst);
+		histogram_frame.assign(thresholds.size() + 1, 0);
+		MarkMulti(buffer.back(), avg, std, thresholds, ground_truth, histogram_frame, histogram_tp, saveMasks ? &masks : nullptr);
+		histogram.resize(histogram_frame.size(), 0);
+		histogram_truth.resize(histogram_frame.size(), 0);
+		for (::size_t k = 0; k != histogram_frame.size(); ++k)
+		{
+			histogram[k] += histogram_frame[k];
+			if (!ground_truth.empty())
+				histogram_truth[k] += histogram_frame[k];
+		}
 
-		// Export output.
-		// TODO: Something is not right.
-		GrayToBGR(dst, out_temp);
-		std::wstring path_dst = ::PathFindFileNameW(filename.c_str());
-		path_dst += L"_.bmp";
-		SaveImageFile(path_dst, out_temp, static_cast<unsigned int>(width), static_cast<unsigned int>(height), wicFactory);
+		if (saveMasks)
+			for (::size_t i = 0; i != thresholds.size(); ++i)
+			{
+				GrayToBGR(masks[i], out_temp);
+				std::wstring path_dst = ::PathFindFileNameW(filename.c_str());
+				path_dst += L"_" + std::to_wstring(thresholds[i]) + L".bmp";
+				SaveImageFile(path_dst, out_temp, static_cast<unsigned int>(width), static_cast<unsigned int>(height), wicFactory);
+			}
+	}
+
+	// Report the accumulated counts of all frames.
+	if (histogram.empty())
+		return;
+	std::vector<::size_t> counts, counts_truth, true_positives;
+	HistogramToCounts(histogram, counts);
+	HistogramToCounts(histogram_truth, counts_truth);
+	HistogramToCounts(histogram_tp, true_positives);
+	if (!pathGroundTruth.empty())
+		std::wclog << L"Ground truth for " << num_truth_frames << L" of " << filenames.size() << L" frames." << std::endl;
+	std::wofstream csv("threshold_sweep.csv");
+	csv << L"threshold,foreground,true_positive,precision,recall" << std::endl;
+	for (::size_t i = 0; i != thresholds.size(); ++i)
+	{
+		double precision = counts_truth[i] != 0 ? static_cast<double>(true_positives[i]) / counts_truth[i] : 0.0;
+		double recall = num_truth != 0 ? static_cast<double>(true_positives[i]) / num_truth : 0.0;
+		csv << thresholds[i] << L"," << counts[i] << L"," << true_positives[i] << L"," << precision << L"," << recall << std::endl;
+		std::wclog << L"Threshold " << thresholds[i] << L": foreground = " << counts[i];
+		if (!pathGroundTruth.empty())
+			std::wclog << L", precision = " << precision << L", recall = " << recall;
+		std::wclog << std::endl;
+	}
+}
+
+// Classify every frame against several window lengths at once using one shared history buffer.
+// The number of foreground pixels per window is written to multi_window.csv, one row per frame.
+void Test1MultiWindow(::IWICImagingFactory *wicFactory, const std::wstring &pathFolder, const std::vector<std::wstring> &filenames,
+	const Test1Options &options, const std::vector<::size_t> &windowLengths)
+{
+	MultiWindowStats stats(windowLengths);
+	::size_t width, height;
+	std::vector<unsigned char> src_data, dst;
+	std::vector<float> avg, std;
+
+	std::wofstream csv("multi_window.csv");
+	csv << L"filename";
+	for (auto len : windowLengths)
+		csv << L",window_" << len;
+	csv << std::endl;
+
+	for (const auto &filename : filenames)
+	{
+		// Load an image file.
+		std::wstring path_src = pathFolder + L"\\" + filename;
+		LoadImageFile(path_src, src_data, width, height, wicFactory);
+		std::vector<float> data;
+		BGRAtoGray_(src_data, data);
+		stats.Push(std::move(data));
+
+		csv << filename;
+		for (::size_t w = 0; w != stats.NumWindows(); ++w)
+		{
+			stats.GetMean(w, avg);
+			stats.GetStd(w, std);
+			csv << L"," << Mark(stats.Latest(), avg, std, options.Threshold, dst);
+		}
+		csv << std::endl;
 	}
+}
 
+// Erosion (or dilation) by the O(kernelWidth * kernelHeight) definition: the min (max) over the window
+// [x - kernelWidth / 2, x - kernelWidth / 2 + kernelWidth) x [y - kernelHeight / 2, ...), ignoring pixels outside
+// the image. Reference for MaskMorphology.
+std::vector<unsigned char> MorphologyReference(const std::vector<unsigned char> &src, int width, int height, int kernelWidth, int kernelHeight, bool erode)
+{
+	std::vector<unsigned char> dst(src.size());
+	for (int y = 0; y != height; ++y)
+		for (int x = 0; x != width; ++x)
+		{
+			unsigned char value(erode ? 0xFF : 0x00);
+			for (int yy = std::max(0, y - kernelHeight / 2); yy < std::min(height, y - kernelHeight / 2 + kernelHeight); ++yy)
+				for (int xx = std::max(0, x - kernelWidth / 2); xx < std::min(width, x - kernelWidth / 2 + kernelWidth); ++xx)
+					value = erode ? std::min(value, src[yy * width + xx]) : std::max(value, src[yy * width + xx]);
+			dst[y * width + x] = value;
+		}
+	return dst;
+}
+
+// Check erosion, dilation, opening and closing against brute-force k x k windows on small masks,
+// then benchmark the mask cleanup on a speckled 1080p mask for kernel sizes 3 - 31.
+// Returns true if every operation matched.
+bool TestMorphology(void)
+{
+	MaskMorphology morphology;
+
+	// Correctness against the O(kw * kh) definition. The widths cover whole SSE2 blocks, tails and rows
+	// narrower than one block.
+	const int SIZES[][2] = { { 37, 23 }, { 5, 40 }, { 64, 3 } };
+	const wchar_t *NAMES[4] = { L"Erode", L"Dilate", L"Open", L"Close" };
+	::size_t num_mismatch[4] = {};
+	for (const auto &size : SIZES)
+	{
+		const int W(size[0]), H(size[1]);
+		std::vector<unsigned char> src(W * H), dst;
+		std::for_each(src.begin(), src.end(), [](unsigned char &value) { value = std::rand() % 3 == 0 ? 0xFF : 0x00; });
+		for (int kw = 1; kw != 10; ++kw)
+			for (int kh = 1; kh != 10; ++kh)
+			{
+				std::vector<unsigned char> eroded = MorphologyReference(src, W, H, kw, kh, true), dilated = MorphologyReference(src, W, H, kw, kh, false);
+				std::vector<unsigned char> refs[4] = { eroded, dilated,
+					MorphologyReference(eroded, W, H, kw, kh, false), MorphologyReference(dilated, W, H, kw, kh, true) };
+				for (int op = 0; op != 4; ++op)
+				{
+					switch (op)
+					{
+					case 0: morphology.Erode(src, dst, W, H, kw, kh); break;
+					case 1: morphology.Dilate(src, dst, W, H, kw, kh); break;
+					case 2: morphology.Open(src, dst, W, H, kw, kh); break;
+					default: morphology.Close(src, dst, W, H, kw, kh); break;
+					}
+					for (::size_t n = 0; n != dst.size(); ++n)
+						num_mismatch[op] += dst[n] != refs[op][n];
+				}
+			}
+	}
+	bool passed(true);
+	for (int op = 0; op != 4; ++op)
+	{
+		std::wclog << (num_mismatch[op] == 0 ? L"[ OK ] " : L"[FAIL] ") << L"MaskMorphology " << NAMES[op]
+			<< L": mismatches against brute force = " << num_mismatch[op] << std::endl;
+		passed = passed && num_mismatch[op] == 0;
+	}
+
+	// Throughput on 1080p.
+	const ::size_t W(1920), H(1080), NUM_REPEAT(20);
+	std::vector<unsigned char> src(W * H), dst;
+	std::for_each(src.begin(), src.end(), [](unsigned char &value) { value = std::rand() % 20 == 0 ? 0xFF : 0x00; });
+	for (::size_t k = 3; k <= 31; k += 2)
+	{
+		::clock_t t_start = ::clock();
+		for (::size_t n = 0; n != NUM_REPEAT; ++n)
+			morphology.Open(src, dst, W, H, k, k);
+		double msec = 1000.0 * (::clock() - t_start) / CLOCKS_PER_SEC / NUM_REPEAT;
+		std::wclog << L"Open " << k << L"x" << k << L" on 1920x1080 = " << msec << L" (msec)" << std::endl;
+	}
+	return passed;
+}
+
+// Compare the native gray reader with LoadImageFile() + BGRAtoGray_() on every file of the folder.
+// WIC has no PGM or PPM codec, so only BMP files are cross-checked and timed against WIC.
+// Reports the time of both paths on the BMP files and the number of them whose gray data differ.
+void TestFastReader(::IWICImagingFactory *wicFactory, const std::wstring &pathFolder, const std::vector<std::wstring> &filenames)
+{
+	std::vector<unsigned char> src_data, row;
+	std::vector<float> data_wic, data_fast;
+	::size_t width, height, num_fast(0), num_checked(0), num_mismatch(0);
+	double sec_wic(0.0), sec_fast(0.0);
+	for (const auto &filename : filenames)
+	{
+		std::wstring path_src = pathFolder + L"\\" + filename;
+		::clock_t t_start = ::clock();
+		bool fast = LoadGrayImageFast(path_src, data_fast, width, height, row);
+		::clock_t t_end = ::clock();
+		if (!fast)
+			continue;	// Not a format the native reader handles.
+		++num_fast;
+
+		char magic[2] = {};
+		std::FILE *file = OpenBinaryFile(path_src);
+		if (file == nullptr)
+			continue;
+		bool is_bmp = std::fread(magic, 1, 2, file) == 2 && magic[0] == 'B' && magic[1] == 'M';
+		std::fclose(file);
+		if (!is_bmp)
+			continue;
+		sec_fast += static_cast<double>(t_end - t_start) / CLOCKS_PER_SEC;
+
+		t_start = ::clock();
+		src_data.clear();
+		LoadImageFile(path_src, src_data, width, height, wicFactory);
+		BGRAtoGray_(src_data, data_wic);
+		sec_wic += static_cast<double>(::clock() - t_start) / CLOCKS_PER_SEC;
+		++num_checked;
+		if (data_wic != data_fast)
+			++num_mismatch;
+	}
+	std::wclog << num_fast << L" files read natively, " << num_checked << L" of them BMP: " << sec_fast << L" (sec) vs WIC "
+		<< sec_wic << L" (sec), " << num_mismatch << L" mismatches" << std::endl;
+}
+
+// Difference of one variant from the reference, accumulated over all frames of TestGolden().
+struct GoldenResult
+{
+	std::wstring Name;
+	double MaxError = 0.0;			// Largest absolute difference of mean, std or gray values.
+	::size_t MaskMismatches = 0;	// Mask pixels which differ from Mark().
+	bool MustBeExact = true;		// False for variants which are allowed to round differently.
+
+	void Compare(const std::vector<float> &a, const std::vector<float> &b)
+	{
+		if (a.size() != b.size())
+			this->MaxError = HUGE_VAL;
+		else
+			for (::size_t n = 0; n != a.size(); ++n)
+			{
+				// Two NaNs (0 / 0 in both) agree; a NaN on one side only is an infinite error.
+				if (a[n] != a[n] || b[n] != b[n])
+				{
+					if ((a[n] != a[n]) != (b[n] != b[n]))
+						this->MaxError = HUGE_VAL;
+				}
+				else
+					this->MaxError = std::max(this->MaxError, static_cast<double>(std::abs(a[n] - b[n])));
+			}
+	}
+	void Compare(const std::vector<unsigned char> &a, const std::vector<unsigned char> &b)
+	{
+		if (a.size() != b.size())
+			this->MaskMismatches += std::max(a.size(), b.size());
+		else
+			for (::size_t n = 0; n != a.size(); ++n)
+				this->MaskMismatches += a[n] != b[n];
+	}
+	bool Passed(void) const { return !this->MustBeExact || (this->MaxError == 0.0 && this->MaskMismatches == 0); }
+};
+
+// Run every kernel and engine variant on generated sequences and compare it with the scalar reference
+// (BGRAtoGray_(), ComputeMean(), ComputeStd(), Mark() and GrayToBGR()). Also checks the mask cleanup
+// against MorphologyReference() and the half-resolution path of Test1RealTime() against a per-pixel
+// definition of the 2x2 average and nearest-neighbor upsampling. Runs entirely in memory.
+// Kernel variants must match exactly; running-sum variants (MultiWindowStats) are only reported.
+// Returns true if every exact variant matched.
+bool TestGolden(void)
+{
+	const ::size_t NUM_FRMS(40), MAX_BUFFER_LENGTH(5);
+	// NOTE: The newest frame is part of its own window, so |x - mean| / std can't exceed sqrt(5 - 1) = 2 here.
+	// Test1's 3.5 would leave every mask empty and prove nothing about Mark().
+	const float TH(1.5f);
+	const ::size_t RESOLUTIONS[][2] = { { 1, 1 }, { 17, 13 }, { 160, 120 }, { 640, 480 } };
+
+	// Kernel levels supported by this CPU, with a few tile configurations each.
+	std::vector<CpuLevel> levels;
+	for (auto level : { CpuLevel::Scalar, CpuLevel::Sse41, CpuLevel::Avx2, CpuLevel::Avx512 })
+		if (level <= DetectCpuLevel())
+			levels.push_back(level);
+	std::vector<TileConfig> tile_configs(3);
+	tile_configs[1].TileSize = 4096;
+	tile_configs[2].TileSize = 1000;	// Not a multiple of any vector width.
+	tile_configs[2].NumThreads = 3;
+
+	std::vector<GoldenResult> results;
+	auto result = [&results](const std::wstring &name, bool mustBeExact) -> GoldenResult &
+	{
+		for (auto &r : results)
+			if (r.Name == name)
+				return r;
+		results.push_back(GoldenResult());
+		results.back().Name = name;
+		results.back().MustBeExact = mustBeExact;
+		return results.back();
+	};
+
+	for (const auto &resolution : RESOLUTIONS)
+	{
+		SyntheticConfig config;
+		config.Width = resolution[0];
+		config.Height = resolution[1];
+		SyntheticSequence sequence(config);
+
+		std::deque<std::vector<float>> buffer;
+		FrameHistory history;
+		history.Allocate(config.Width * config.Height, MAX_BUFFER_LENGTH, true);
+		WorkerPool pool(tile_configs[2].NumThreads - 1, std::vector<unsigned int>(1, 0));
+		std::vector<::size_t> window_lengths(1, MAX_BUFFER_LENGTH);
+		MultiWindowStats multi_window(window_lengths);
+		std::vector<float> gray, ref_gray, ref_avg, ref_std, avg, std;
+		std::vector<unsigned char> bgra, ref_mask, mask, ref_bgr, bgr;
+		for (::size_t f = 0; f != NUM_FRMS; ++f)
+		{
+			sequence.Next(gray);
+
+			// Gray conversion from a BGRA frame with distinct channels.
+			bgra.resize(gray.size() * 4);
+			for (::size_t n = 0; n != gray.size(); ++n)
+			{
+				unsigned char value = static_cast<unsigned char>(gray[n]);
+				bgra[4 * n] = value;
+				bgra[4 * n + 1] = static_cast<unsigned char>(value + 1);
+				bgra[4 * n + 2] = static_cast<unsigned char>(value + 2);
+				bgra[4 * n + 3] = 0xFF;
+			}
+			BGRAtoGray_(bgra, ref_gray);
+			for (auto level : levels)
+			{
+				const PixelKernels &kernels = GetPixelKernels(level);
+				std::vector<float> converted(gray.size());
+				kernels.BgraToGray(bgra.data(), converted.data(), converted.size());
+				result(std::wstring(L"BgraToGray ") + kernels.Name, true).Compare(ref_gray, converted);
+			}
+
+			// Reference model.
+			if (buffer.size() == MAX_BUFFER_LENGTH)
+				buffer.pop_front();
+			buffer.push_back(ref_gray);
+			ComputeMean(buffer, ref_avg);
+			ComputeStd(buffer, ref_avg, ref_std);
+			::size_t ref_count = Mark(buffer.back(), ref_avg, ref_std, TH, ref_mask);
+			GrayToBGR(ref_mask, ref_bgr);
+
+			// Kernel engine at every level and tiling.
+			for (auto level : levels)
+			{
+				const PixelKernels &kernels = GetPixelKernels(level);
+				for (const auto &tile_config : tile_configs)
+				{
+					std::wstring name = std::wstring(L"Model ") + kernels.Name + L" tile " + std::to_wstring(tile_config.TileSize)
+						+ L" x" + std::to_wstring(tile_config.NumThreads);
+					GoldenResult &r = result(name, true);
+					::size_t count = ComputeModelTiled(kernels, tile_config, buffer, TH, avg, std, mask);
+					r.Compare(ref_avg, avg);
+					r.Compare(ref_std, std);
+					r.Compare(ref_mask, mask);
+					if (count != ref_count)
+						r.MaskMismatches += count > ref_count ? count - ref_count : ref_count - count;
+				}
+				bgr.resize(ref_mask.size() * 3);
+				kernels.GrayToBgr(ref_mask.data(), bgr.data(), ref_mask.size());
+				result(std::wstring(L"GrayToBgr ") + kernels.Name, true).Compare(ref_bgr, bgr);
+			}
+
+			// Huge-page history with a pool of pinned worker threads.
+			{
+				TileConfig pinned = tile_configs[2];
+				pinned.Pool = &pool;
+				std::copy(ref_gray.cbegin(), ref_gray.cend(), history.Reserve());
+				history.Push();
+				const ::size_t sz = history.FrameSize();
+				::size_t count = ComputeModelTiled(SelectPixelKernels(), pinned, history.Frames(), sz, TH, history.Mean(), history.Std(), history.Mask());
+				GoldenResult &r = result(L"FrameHistory", true);
+				r.Compare(ref_avg, std::vector<float>(history.Mean(), history.Mean() + sz));
+				r.Compare(ref_std, std::vector<float>(history.Std(), history.Std() + sz));
+				r.Compare(ref_mask, std::vector<unsigned char>(history.Mask(), history.Mask() + sz));
+				if (count != ref_count)
+					r.MaskMismatches += count > ref_count ? count - ref_count : ref_count - count;
+			}
+
+			// Single-pass threshold sweep with the reference threshold in the middle.
+			{
+				std::vector<float> thresholds;
+				thresholds.push_back(TH * 0.5f);
+				thresholds.push_back(TH);
+				thresholds.push_back(TH * 2.0f);
+				std::vector<::size_t> histogram, histogram_tp;
+				std::vector<std::vector<unsigned char>> masks;
+				MarkMulti(buffer.back(), ref_avg, ref_std, thresholds, std::vector<unsigned char>(), histogram, histogram_tp, &masks);
+				result(L"MarkMulti", true).Compare(ref_mask, masks[1]);
+			}
+
+			// Half-resolution classification as in Test1RealTime(): 2x2 averages of the frame and the model,
+			// Mark() at half resolution and every half-resolution pixel copied to its 2x2 block.
+			if (config.Width >= 2 && config.Height >= 2)
+			{
+				const ::size_t w = config.Width, h = config.Height, w_half = w / 2, h_half = h / 2;
+				auto average = [=](const std::vector<float> &src, std::vector<float> &dst)
+				{
+					dst.assign(w_half * h_half, 0.0f);
+					for (::size_t y = 0; y != h_half; ++y)
+						for (::size_t x = 0; x != w_half; ++x)
+						{
+							const ::size_t n = 2 * y * w + 2 * x;
+							dst[y * w_half + x] = (src[n] + src[n + 1] + src[n + w] + src[n + w + 1]) * 0.25f;
+						}
+				};
+				std::vector<float> ref_half_data, ref_half_avg, ref_half_std, half_data, half_avg, half_std;
+				std::vector<unsigned char> ref_half_mask, ref_full_mask(w * h), half_mask, full_mask;
+				average(buffer.back(), ref_half_data);
+				average(ref_avg, ref_half_avg);
+				average(ref_std, ref_half_std);
+				Mark(ref_half_data, ref_half_avg, ref_half_std, TH, ref_half_mask);
+				// The last row (column) of an odd height (width) takes the mask of the row (column) before it.
+				for (::size_t y = 0; y != h; ++y)
+					for (::size_t x = 0; x != w; ++x)
+						ref_full_mask[y * w + x] = ref_half_mask[(y / 2 == h_half ? h_half - 1 : y / 2) * w_half + (x / 2 == w_half ? w_half - 1 : x / 2)];
+
+				DownsampleHalf(buffer.back().data(), w, h, half_data);
+				DownsampleHalf(ref_avg.data(), w, h, half_avg);
+				DownsampleHalf(ref_std.data(), w, h, half_std);
+				GoldenResult &r_down = result(L"DownsampleHalf", true);
+				r_down.Compare(ref_half_data, half_data);
+				r_down.Compare(ref_half_avg, half_avg);
+				r_down.Compare(ref_half_std, half_std);
+				UpsampleHalf(ref_half_mask, w, h, full_mask);
+				result(L"UpsampleHalf", true).Compare(ref_full_mask, full_mask);
+				for (auto level : levels)
+				{
+					const PixelKernels &kernels = GetPixelKernels(level);
+					half_mask.resize(half_data.size());
+					kernels.Mark(half_data.data(), half_avg.data(), half_std.data(), TH, half_mask.data(), half_mask.size());
+					UpsampleHalf(half_mask, w, h, full_mask);
+					result(std::wstring(L"Half resolution ") + kernels.Name, true).Compare(ref_full_mask, full_mask);
+				}
+			}
+
+			// Mask cleanup, on every 8th frame because the brute-force reference is O(k^2) per pixel.
+			if (f % 8 == 0)
+			{
+				const int w = static_cast<int>(config.Width), h = static_cast<int>(config.Height);
+				MaskMorphology morphology;
+				GoldenResult &r = result(L"MaskMorphology", true);
+				for (int k = 2; k <= 5; k += 3)
+				{
+					std::vector<unsigned char> eroded = MorphologyReference(ref_mask, w, h, k, k + 1, true);
+					std::vector<unsigned char> dilated = MorphologyReference(ref_mask, w, h, k, k + 1, false);
+					morphology.Open(ref_mask, mask, w, h, k, k + 1);
+					r.Compare(MorphologyReference(eroded, w, h, k, k + 1, false), mask);
+					morphology.Close(ref_mask, mask, w, h, k, k + 1);
+					r.Compare(MorphologyReference(dilated, w, h, k, k + 1, true), mask);
+				}
+			}
+
+			// Running sums over a shared history.
+			{
+				multi_window.Push(std::vector<float>(ref_gray));
+				multi_window.GetMean(0, avg);
+				multi_window.GetStd(0, std);
+				GoldenResult &r = result(L"MultiWindowStats", false);
+				r.Compare(ref_avg, avg);
+				r.Compare(ref_std, std);
+				Mark(multi_window.Latest(), avg, std, TH, mask);
+				r.Compare(ref_mask, mask);
+			}
+		}
+	}
+
+	bool passed(true);
+	for (const auto &r : results)
+	{
+		std::wclog << (r.Passed() ? L"[ OK ] " : L"[FAIL] ") << r.Name << L": max error = " << r.MaxError
+			<< L", mask mismatches = " << r.MaskMismatches << (r.MustBeExact ? L"" : L" (not required to be exact)") << std::endl;
+		passed = passed && r.Passed();
+	}
+	return passed;
+}
+
+// Output modes of Test1Benchmark().
+enum class BenchmarkOutput
+{
+	None,		// Masks are computed but not written.
+	Stream,		// One Y4M stream.
+	Bmp			// One BMP per frame through WIC, as Test1() does by default.
+};
+
+inline const wchar_t *BenchmarkOutputName(BenchmarkOutput output)
+{
+	switch (output)
+	{
+	case BenchmarkOutput::Stream: return L"stream";
+	case BenchmarkOutput::Bmp: return L"bmp";
+	default: return L"none";
+	}
+}
+
+// Write a gray frame as a binary PGM file.
+bool SaveGrayPgm(const std::wstring &pathDst, const std::vector<float> &src, ::size_t width, ::size_t height)
+{
+	std::FILE *file = OpenBinaryFile(pathDst, true);
+	if (file == nullptr)
+		return false;
+	std::vector<unsigned char> pixels(src.size());
+	for (::size_t n = 0; n != src.size(); ++n)
+		pixels[n] = static_cast<unsigned char>(src[n]);
+	bool succeeded = std::fprintf(file, "P5\n%u %u\n255\n", static_cast<unsigned int>(width), static_cast<unsigned int>(height)) > 0 &&
+		std::fwrite(pixels.data(), 1, pixels.size(), file) == pixels.size();
+	return std::fclose(file) == 0 && succeeded;
+}
+
+// End-to-end benchmark of Test1(): decode, model, classify and output, for every combination of resolution,
+// window length, thread count and output mode. The input is a synthetic sequence written as PGM files to the
+// temporary folder, so it is served from the file cache and every run decodes identical data. Each configuration
+// is timed from the best of a few runs.
+// Results go to benchmark_results.csv. If pathBaseline exists, every configuration is compared with it and the ones
+// slower than the baseline by more than 'tolerance' are flagged; otherwise the results are saved as the new baseline.
+// Returns false if there is a regression.
+bool Test1Benchmark(::IWICImagingFactory *wicFactory, const std::vector<std::pair<::size_t, ::size_t>> &resolutions,
+	const std::vector<::size_t> &windowLengths, const std::vector<unsigned int> &threadCounts,
+	const std::vector<BenchmarkOutput> &outputs, ::size_t numFrames, const std::string &pathBaseline, double tolerance)
+{
+	const ::size_t NUM_REPEAT(3);
+	wchar_t path_temp[MAX_PATH];
+	if (::GetTempPathW(MAX_PATH, path_temp) == 0)
+	{
+		std::wclog << L"Failed to find the temporary folder." << std::endl;
+		return false;
+	}
+	const std::wstring path_folder = std::wstring(path_temp) + L"bgs_benchmark";
+	::CreateDirectoryW(path_folder.c_str(), nullptr);
+	const ::size_t max_window = windowLengths.empty() ? 0 : *std::max_element(windowLengths.cbegin(), windowLengths.cend());
+
+	std::vector<BenchmarkResult> results;
+	for (const auto &resolution : resolutions)
+	{
+		// Frames for the longest window to fill up, followed by the measured ones.
+		SyntheticConfig source;
+		source.Width = resolution.first;
+		source.Height = resolution.second;
+		SyntheticSequence sequence(source);
+		std::vector<std::wstring> filenames(max_window + numFrames);
+		std::vector<float> frame;
+		for (::size_t n = 0; n != filenames.size(); ++n)
+		{
+			filenames[n] = L"frame_" + std::to_wstring(n) + L".pgm";
+			sequence.Next(frame);
+			if (!SaveGrayPgm(path_folder + L"\\" + filenames[n], frame, source.Width, source.Height))
+			{
+				std::wclog << L"Failed to write " << filenames[n] << L" to " << path_folder << std::endl;
+				return false;
+			}
+		}
+
+		for (auto window : windowLengths)
+			for (auto num_threads : threadCounts)
+				for (auto output : outputs)
+				{
+					if (output == BenchmarkOutput::Bmp && wicFactory == nullptr)
+						continue;
+					Test1Options options;
+					options.MaxBufferLength = window;
+					options.AutoTune = false;
+					options.Tiles.NumThreads = num_threads;
+					options.Tiles.TileSize = num_threads > 1 ? 64 * 1024 : 0;
+					options.WriteStream = output == BenchmarkOutput::Stream;
+					options.PathStream = path_folder + L"\\masks.y4m";
+					options.PathOutput = path_folder;
+					// No frame reaches this many foreground pixels, so nothing is written.
+					if (output == BenchmarkOutput::None)
+						options.ActivityThreshold = static_cast<::size_t>(-1);
+
+					// Keep the best of a few runs, so one preempted run doesn't look like a regression.
+					std::vector<std::wstring> run(filenames.cbegin() + (max_window - window), filenames.cend());
+					double sec(-1.0);
+					// Memory is sampled on the first run only. Emptying the working set before it slows that run down,
+					// and only the fastest run is kept anyway.
+					ResidentSampler memory;
+					for (::size_t n = 0; n != NUM_REPEAT; ++n)
+					{
+						if (n == 0)
+							memory.Start();
+						auto t_start = PrecisionClock::now();
+						Test1(wicFactory, path_folder, run, options);
+						double elapsed = std::chrono::duration<double>(PrecisionClock::now() - t_start).count();
+						if (n == 0)
+							memory.Stop();
+						if (sec < 0.0 || elapsed < sec)
+							sec = elapsed;
+					}
+
+					BenchmarkResult result;
+					std::wostringstream name;
+					name << source.Width << L"x" << source.Height << L"_w" << window << L"_t" << num_threads << L"_" << BenchmarkOutputName(output);
+					result.Name = name.str();
+					result.NumFrames = run.size();
+					result.NumPixels = source.Width * source.Height;
+					result.Seconds = sec;
+					result.Fps = sec > 0.0 ? result.NumFrames / sec : 0.0;
+					result.NsPerPixel = sec * 1e9 / (result.NumFrames * result.NumPixels);
+					result.PeakRss = memory.PeakDelta();
+					results.push_back(result);
+					std::wclog << result.Name << L": " << result.Fps << L" (fps), " << result.NsPerPixel << L" (ns/pixel), peak RSS +"
+						<< result.PeakRss / (1024 * 1024) << L" (MB)" << std::endl;
+				}
+
+		for (const auto &filename : filenames)
+		{
+			::DeleteFileW((path_folder + L"\\" + filename).c_str());
+			::DeleteFileW((path_folder + L"\\" + filename + L"_.bmp").c_str());
+		}
+	}
+	::DeleteFileW((path_folder + L"\\masks.y4m").c_str());
+	WriteBenchmarkResults("benchmark_results.csv", results);
+
+	std::vector<BenchmarkResult> baseline;
+	if (!LoadBenchmarkResults(pathBaseline, baseline))
+	{
+		std::wclog << L"No baseline found; saving the results as the baseline." << std::endl;
+		WriteBenchmarkResults(pathBaseline, results);
+		return true;
+	}
+	::size_t num_regressions = CompareWithBaseline(results, baseline, tolerance);
+	std::wclog << num_regressions << L" of " << results.size() << L" configurations are more than " << tolerance * 100.0
+		<< L"% slower than the baseline." << std::endl;
+	return num_regressions == 0;
+}
+
+// Per-frame latency of the model on synthetic frames of width x height with a window of windowLength frames, with and
+// without huge pages for the history and model planes, and with and without pinning the threads to 'cores'.
+// Every variant uses one thread per core in 'cores'. A frame is copied into the history (standing in for decoding)
+// and the model and mask are computed. Mean, standard deviation, 99th percentile and maximum of the latency are
+// logged and written to latency_jitter.csv.
+void TestLatencyJitter(::size_t width, ::size_t height, ::size_t windowLength, ::size_t numFrames, const std::vector<unsigned int> &cores)
+{
+	const float TH(3.5f);
+	const ::size_t sz = width * height;
+	const PixelKernels &kernels = SelectPixelKernels();
+
+	// A few distinct frames are enough; generating them takes longer than processing them.
+	SyntheticConfig source;
+	source.Width = width;
+	source.Height = height;
+	SyntheticSequence sequence(source);
+	std::vector<std::vector<float>> frames(8);
+	for (auto &frame : frames)
+		sequence.Next(frame);
+
+	std::wofstream csv("latency_jitter.csv");
+	csv << L"huge_pages,pinned,pages,mean_ms,std_ms,p99_ms,max_ms" << std::endl;
+	for (int huge_pages = 0; huge_pages != 2; ++huge_pages)
+		for (int pinned = 0; pinned != 2; ++pinned)
+		{
+			TileConfig config;
+			config.NumThreads = static_cast<unsigned int>(std::max<::size_t>(1, cores.size()));
+			config.TileSize = config.NumThreads > 1 ? 64 * 1024 : 0;
+			if (pinned)
+				config.Cores = cores;
+
+			std::vector<double> latencies;
+			PageKind pages(PageKind::Normal);
+			// Run on a separate thread, so pinning doesn't stick to the calling thread.
+			std::thread runner([&]()
+			{
+				FrameHistory history;
+				if (!history.Allocate(sz, windowLength, huge_pages != 0))
+				{
+					std::wclog << L"Failed to allocate " << windowLength << L" frames of " << width << L"x" << height << std::endl;
+					return;
+				}
+				pages = history.Kind();
+				if (pinned && !cores.empty())
+					PinCurrentThread(cores[0]);
+				std::unique_ptr<WorkerPool> pool;
+				AttachWorkerPool(config, pool, config.Cores);
+				for (::size_t n = 0; n != windowLength + numFrames; ++n)
+				{
+					auto t_start = PrecisionClock::now();
+					std::copy(frames[n % frames.size()].cbegin(), frames[n % frames.size()].cend(), history.Reserve());
+					history.Push();
+					ComputeModelTiled(kernels, config, history.Frames(), sz, TH, history.Mean(), history.Std(), history.Mask());
+					// The window fills up first, which also faults in every page of the history.
+					if (n >= windowLength)
+						latencies.push_back(std::chrono::duration<double>(PrecisionClock::now() - t_start).count() * 1000.0);
+				}
+			});
+			runner.join();
+			if (latencies.empty())
+				continue;
+
+			double mean = std::accumulate(latencies.cbegin(), latencies.cend(), 0.0) / latencies.size();
+			double var(0.0);
+			for (auto latency : latencies)
+				var += (latency - mean) * (latency - mean);
+			double std = std::sqrt(var / latencies.size());
+			std::sort(latencies.begin(), latencies.end());
+			double p99 = latencies[std::min(latencies.size() - 1, latencies.size() * 99 / 100)];
+			std::wclog << (huge_pages ? L"Huge pages" : L"Normal pages") << L" (" << PageKindName(pages) << L"), "
+				<< (pinned ? L"pinned" : L"not pinned") << L": mean " << mean << L" (ms), std " << std << L" (ms), p99 " << p99
+				<< L" (ms), max " << latencies.back() << L" (ms)" << std::endl;
+			csv << huge_pages << L"," << pinned << L"," << PageKindName(pages) << L"," << mean << L"," << std << L"," << p99 << L","
+				<< latencies.back() << std::endl;
+		}
+}
+
+// Reference consumer of the shared memory ring which Test1() publishes with Test1Options::SharedRingName.
+// Waits for the ring to appear, then polls the newest frame and reads its mask in place. Stops when no new frame has
+// arrived for idleSeconds. Reports the frames seen, the frames missed because the consumer was too slow to see
+// them as the newest one, and the reads invalidated because the producer overwrote the slot while it was read.
+void ConsumeSharedFrames(const std::wstring &name, double idleSeconds)
+{
+	typedef std::chrono::steady_clock Clock;
+	SharedFrameRing ring;
+	auto t_last = Clock::now();
+	while (!ring.Open(name))
+	{
+		if (std::chrono::duration<double>(Clock::now() - t_last).count() > idleSeconds)
+		{
+			std::wclog << L"No shared memory ring " << name << std::endl;
+			return;
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	}
+
+	unsigned int last_sequence(0);
+	::size_t num_received(0), num_missed(0), num_torn(0), num_mismatched(0);
+	SharedFrameView view;
+	while (std::chrono::duration<double>(Clock::now() - t_last).count() < idleSeconds)
+	{
+		if (ring.LatestSequence() == last_sequence || !ring.Latest(view) || view.PublishSequence == last_sequence)
+		{
+			std::this_thread::yield();
+			continue;
+		}
+
+		// Stand-in for a tracker: count the foreground pixels straight from shared memory.
+		::size_t num_foreground = static_cast<::size_t>(std::count(view.Mask, view.Mask + view.Width * view.Height, 0xFF));
+		if (!ring.IsValid(view))
+		{
+			++num_torn;
+			continue;
+		}
+		if (num_foreground != view.NumForeground)
+			++num_mismatched;
+		num_missed += view.PublishSequence - last_sequence - 1;
+		last_sequence = view.PublishSequence;
+		++num_received;
+		t_last = Clock::now();
+	}
+	std::wclog << L"Consumed " << num_received << L" frames from " << name << L", " << num_missed << L" missed, "
+		<< num_torn << L" torn reads discarded, " << num_mismatched << L" inconsistent masks." << std::endl;
 }
 
 // Report total computation time as a log message and a message box.
@@ -463,8 +1935,83 @@ void ReportTime(::clock_t tStart, ::clock_t tEnd)
 	::MessageBoxW(nullptr, msg_time.c_str(), L"Completed", MB_OK | MB_ICONINFORMATION);
 }
 
-int main(void)
+// Run every test on the image files of a folder chosen by the user.
+void RunTests(::IWICImagingFactory *wicFactory)
 {
+	// Validate every optimized variant against the reference before running anything with them.
+	if (!TestGolden())
+		::MessageBoxW(nullptr, L"Optimized kernels don't match the reference. See the log for details.", L"Error", MB_OK);
+
+	// Load which folder to read files.
+	std::vector<std::wstring> filenames;
+	std::wstring path_folder;
+	LoadFileList(path_folder, filenames);
+
+	::clock_t t_start, t_end;
+
+	t_start = ::clock();
+	Test0(wicFactory, path_folder, filenames);			
+	t_end = ::clock();
+	ReportTime(t_start, t_end);
+
+	Test1Options options;
+	options.PathSnapshot = L"background_model.snapshot";
+	options.SharedRingName = L"BackgroundSubtraction";
+	t_start = ::clock();
+	Test1(wicFactory, path_folder, filenames, options);
+	t_end = ::clock();
+	ReportTime(t_start, t_end);
+
+	std::vector<::size_t> counts;
+	t_start = ::clock();
+	Test1Chunked(path_folder, filenames, Test1Options(), 0, counts);
+	t_end = ::clock();
+	ReportTime(t_start, t_end);
+
+	// A 720p live feed at twice the usual frame rate, which needs load shedding on slower machines.
+	SyntheticConfig source;
+	source.Width = 1280;
+	source.Height = 720;
+	Test1Options options_realtime;
+	FrameQueue queue;
+	RealTimeMetrics metrics;
+	t_start = ::clock();
+	std::thread producer(ReplaySyntheticSource, std::ref(queue), source, 60.0, 600, 2 * options_realtime.MaxBufferLength + 16);
+	Test1RealTime(queue, source.Width, source.Height, options_realtime, metrics);
+	producer.join();
+	t_end = ::clock();
+	ReportTime(t_start, t_end);
+
+	std::vector<float> thresholds;
+	for (int n = 0; n != 20; ++n)
+		thresholds.push_back(1.0f + 0.25f * n);
+	t_start = ::clock();
+	Test1Sweep(wicFactory, path_folder, filenames, Test1Options(), thresholds, L"", false);
+	t_end = ::clock();
+	ReportTime(t_start, t_end);
+
+	std::vector<::size_t> window_lengths;
+	window_lengths.push_back(5);
+	window_lengths.push_back(30);
+	window_lengths.push_back(120);
+	t_start = ::clock();
+	Test1MultiWindow(wicFactory, path_folder, filenames, Test1Options(), window_lengths);
+	t_end = ::clock();
+	ReportTime(t_start, t_end);
+
+	if (!TestMorphology())
+		::MessageBoxW(nullptr, L"Mask morphology doesn't match the brute-force reference. See the log for details.", L"Error", MB_OK);
+	TestFastReader(wicFactory, path_folder, filenames);
+
+	std::vector<unsigned int> cores;
+	for (unsigned int n = 0; n != std::min(4u, std::max(1u, std::thread::hardware_concurrency())); ++n)
+		cores.push_back(n);
+	TestLatencyJitter(1920, 1080, 30, 120, cores);
+}
+
+int main(int argc, char *argv[])
+{
+	int exit_code(0);
 	// NOTE: if multi-threading option is selected for COM initialization, it can not recognize files in the user library. Don't know why.
 	if (SUCCEEDED(::CoInitializeEx(nullptr, ::COINIT_APARTMENTTHREADED | ::COINIT_DISABLE_OLE1DDE)))
 	//if (SUCCEEDED(::CoInitializeEx(nullptr, ::COINIT_MULTITHREADED | ::COINIT_DISABLE_OLE1DDE)))
@@ -472,22 +2019,33 @@ int main(void)
 		::IWICImagingFactory *wic_factory(nullptr);	// __uuidof(IWICImagingFactory)
 		if (SUCCEEDED(::CoCreateInstance(::CLSID_WICImagingFactory, nullptr, CLSCTX_ALL, IID_PPV_ARGS(&wic_factory))))
 		{
-			// Load which folder to read files.
-			std::vector<std::wstring> filenames;
-			std::wstring path_folder;
-			LoadFileList(path_folder, filenames);
-
-			::clock_t t_start, t_end;
-
-			t_start = ::clock();
-			Test0(wic_factory, path_folder, filenames);			
-			t_end = ::clock();
-			ReportTime(t_start, t_end);
-
-			t_start = ::clock();
-			Test1(wic_factory, path_folder, filenames);
-			t_end = ::clock();
-			ReportTime(t_start, t_end);
+			// --benchmark runs only the end-to-end benchmark and reports regressions in the exit code.
+			if (argc > 1 && std::strcmp(argv[1], "--benchmark") == 0)
+			{
+				std::vector<std::pair<::size_t, ::size_t>> resolutions;
+				resolutions.push_back(std::make_pair(640, 480));
+				resolutions.push_back(std::make_pair(1920, 1080));
+				std::vector<::size_t> window_lengths;
+				window_lengths.push_back(5);
+				window_lengths.push_back(30);
+				std::vector<unsigned int> thread_counts;
+				thread_counts.push_back(1);
+				thread_counts.push_back(std::max(1u, std::thread::hardware_concurrency()));
+				std::vector<BenchmarkOutput> outputs;
+				outputs.push_back(BenchmarkOutput::None);
+				outputs.push_back(BenchmarkOutput::Stream);
+				outputs.push_back(BenchmarkOutput::Bmp);
+				if (!Test1Benchmark(wic_factory, resolutions, window_lengths, thread_counts, outputs, 60, "benchmark_baseline.csv", 0.1))
+					exit_code = 1;
+			}
+			// --consume <name> runs the reference consumer of the shared memory ring published by another instance.
+			else if (argc > 2 && std::strcmp(argv[1], "--consume") == 0)
+			{
+				std::string name(argv[2]);
+				ConsumeSharedFrames(std::wstring(name.cbegin(), name.cend()), 5.0);
+			}
+			else
+				RunTests(wic_factory);
 
 			wic_factory->Release();
 		}
@@ -496,4 +2054,5 @@ int main(void)
 
 		::CoUninitialize();
 	}
+	return exit_code;
 }
\ No newline at end of file
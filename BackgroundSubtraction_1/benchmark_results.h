@@ -0,0 +1,152 @@
+#if !defined(BENCHMARK_RESULTS_H)
+#define BENCHMARK_RESULTS_H
+
+// Standard C++ header files.
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+
+// Windows header files.
+#include <Windows.h>
+#include <Psapi.h>
+
+// Result of one configuration of the end-to-end benchmark.
+struct BenchmarkResult
+{
+	std::wstring Name;				// Identifies the configuration; results are matched with the baseline by name.
+	::size_t NumFrames = 0;
+	::size_t NumPixels = 0;			// Per frame.
+	double Seconds = 0.0;
+	double Fps = 0.0;
+	double NsPerPixel = 0.0;
+	::size_t PeakRss = 0;			// Peak working set while this configuration ran, above the one before it, in bytes.
+};
+
+// Current working set of this process in bytes.
+inline ::size_t ResidentBytes(void)
+{
+	::PROCESS_MEMORY_COUNTERS counters = {};
+	counters.cb = sizeof(counters);
+	if (!::GetProcessMemoryInfo(::GetCurrentProcess(), &counters, sizeof(counters)))
+		return 0;
+	return counters.WorkingSetSize;
+}
+
+// Peak working set between Start() and Stop(), sampled on a background thread. The peak working set Windows keeps
+// only ever grows over the lifetime of the process, so it can't tell one configuration from the next.
+// Start() empties the working set first, so PeakDelta() is the memory the measured code touched, not what earlier
+// code left resident. Peaks shorter than the sampling interval can be missed; frame buffers live much longer.
+class ResidentSampler
+{
+public:
+	ResidentSampler(void) : Running(false) {}
+	ResidentSampler(const ResidentSampler &) = delete;
+	ResidentSampler &operator=(const ResidentSampler &) = delete;
+	~ResidentSampler(void) { this->Stop(); }
+
+	void Start(void)
+	{
+		this->Stop();
+		::SetProcessWorkingSetSize(::GetCurrentProcess(), static_cast<SIZE_T>(-1), static_cast<SIZE_T>(-1));
+		this->Baseline = this->Peak = ResidentBytes();
+		this->Running = true;
+		this->Sampler = std::thread([this]()
+		{
+			while (this->Running)
+			{
+				this->Peak = std::max(this->Peak, ResidentBytes());
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			}
+		});
+	}
+
+	void Stop(void)
+	{
+		if (!this->Sampler.joinable())
+			return;
+		this->Running = false;
+		this->Sampler.join();
+		this->Peak = std::max(this->Peak, ResidentBytes());
+	}
+
+	::size_t PeakDelta(void) const { return this->Peak > this->Baseline ? this->Peak - this->Baseline : 0; }
+
+protected:
+	std::thread Sampler;
+	std::atomic<bool> Running;
+	::size_t Baseline = 0, Peak = 0;
+};
+
+// Write results as CSV with a header line. The same file can be used as a baseline later.
+inline bool WriteBenchmarkResults(const std::string &pathDst, const std::vector<BenchmarkResult> &results)
+{
+	std::wofstream csv(pathDst);
+	if (!csv)
+		return false;
+	csv << L"name,frames,pixels,seconds,fps,ns_per_pixel,peak_rss_delta_bytes" << std::endl;
+	for (const auto &result : results)
+		csv << result.Name << L"," << result.NumFrames << L"," << result.NumPixels << L"," << result.Seconds << L","
+			<< result.Fps << L"," << result.NsPerPixel << L"," << result.PeakRss << std::endl;
+	return static_cast<bool>(csv);
+}
+
+// Read a file written by WriteBenchmarkResults(). Returns false if it doesn't exist or a line is malformed.
+inline bool LoadBenchmarkResults(const std::string &pathSrc, std::vector<BenchmarkResult> &results)
+{
+	results.clear();
+	std::wifstream csv(pathSrc);
+	if (!csv)
+		return false;
+	std::wstring line;
+	std::getline(csv, line);	// Header.
+	while (std::getline(csv, line))
+	{
+		if (line.empty())
+			continue;
+		std::wistringstream fields(line);
+		BenchmarkResult result;
+		wchar_t sep[6];
+		if (!std::getline(fields, result.Name, L',') ||
+			!(fields >> result.NumFrames >> sep[0] >> result.NumPixels >> sep[1] >> result.Seconds >> sep[2]
+				>> result.Fps >> sep[3] >> result.NsPerPixel >> sep[4] >> result.PeakRss))
+			return false;
+		results.push_back(result);
+	}
+	return true;
+}
+
+// Compare every result with the baseline entry of the same name and log the change of ns/pixel.
+// A result is a regression if it is slower than the baseline by more than 'tolerance' (0.1 = 10%).
+// Results without a baseline entry are reported but never flagged. Returns the number of regressions.
+inline ::size_t CompareWithBaseline(const std::vector<BenchmarkResult> &results, const std::vector<BenchmarkResult> &baseline,
+	double tolerance)
+{
+	::size_t num_regressions(0);
+	for (const auto &result : results)
+	{
+		const BenchmarkResult *reference(nullptr);
+		for (const auto &entry : baseline)
+			if (entry.Name == result.Name)
+				reference = &entry;
+		if (reference == nullptr || reference->NsPerPixel <= 0.0)
+		{
+			std::wclog << result.Name << L": " << result.NsPerPixel << L" ns/pixel, no baseline" << std::endl;
+			continue;
+		}
+		double change = result.NsPerPixel / reference->NsPerPixel - 1.0;
+		bool regressed = change > tolerance;
+		if (regressed)
+			++num_regressions;
+		std::wclog << result.Name << L": " << result.NsPerPixel << L" ns/pixel, baseline " << reference->NsPerPixel
+			<< L" (" << (change >= 0.0 ? L"+" : L"") << change * 100.0 << L"%)" << (regressed ? L" REGRESSION" : L"") << std::endl;
+	}
+	return num_regressions;
+}
+
+#endif
@@ -0,0 +1,101 @@
+#if !defined(EVENT_RECORDER_H)
+#define EVENT_RECORDER_H
+
+// Standard C++ header files.
+#include <string>
+#include <vector>
+#include <functional>
+
+// Output policy which writes only the frames around foreground activity.
+// A frame is active if its number of foreground pixels reaches the activity threshold. Inactive frames are
+// kept in a small in-memory ring, which costs one copy of the mask and no encoding or I/O. When a frame
+// becomes active, the ring is flushed first (pre-roll), then the active frames are written, followed by
+// up to postRoll inactive frames. Frames that fall off the ring are never written.
+// An activity threshold of 0 writes every frame.
+class EventRecorder
+{
+public:
+	// Called with the output name and the mask of every frame which is written out, in frame order.
+	typedef std::function<void(const std::wstring &name, const std::vector<unsigned char> &mask)> Writer;
+
+	EventRecorder(::size_t activityThreshold, ::size_t preRoll, ::size_t postRoll, Writer writer) :
+		ActivityThreshold(activityThreshold), PostRoll(postRoll), Write(writer), Ring(preRoll) {}
+
+	void Push(const std::wstring &name, const std::vector<unsigned char> &mask, ::size_t numForeground);
+
+	::size_t NumEvents(void) const { return this->Events; }
+	::size_t NumWritten(void) const { return this->Written; }
+	// Frames which have been dropped so far, including the ones still waiting in the pre-roll ring.
+	::size_t NumSkipped(void) const { return this->Dropped + this->RingSize; }
+
+protected:
+	struct Slot
+	{
+		std::wstring Name;
+		std::vector<unsigned char> Mask;
+	};
+
+	::size_t ActivityThreshold, PostRoll;
+	Writer Write;
+	std::vector<Slot> Ring;
+	::size_t RingBegin = 0, RingSize = 0;
+	bool InEvent = false;
+	::size_t PostRemaining = 0;
+	::size_t Events = 0, Written = 0, Dropped = 0;
+};
+
+inline void EventRecorder::Push(const std::wstring &name, const std::vector<unsigned char> &mask, ::size_t numForeground)
+{
+	if (numForeground >= this->ActivityThreshold)
+	{
+		if (!this->InEvent)
+		{
+			// A new event starts; write its pre-roll in order first.
+			++this->Events;
+			for (::size_t n = 0; n != this->RingSize; ++n)
+			{
+				const Slot &slot = this->Ring[(this->RingBegin + n) % this->Ring.size()];
+				this->Write(slot.Name, slot.Mask);
+				++this->Written;
+			}
+			this->RingBegin = 0;
+			this->RingSize = 0;
+			this->InEvent = true;
+		}
+		this->Write(name, mask);
+		++this->Written;
+		this->PostRemaining = this->PostRoll;
+	}
+	else if (this->InEvent && this->PostRemaining != 0)
+	{
+		// Post-roll of the current event.
+		this->Write(name, mask);
+		++this->Written;
+		if (--this->PostRemaining == 0)
+			this->InEvent = false;
+	}
+	else
+	{
+		// Idle; keep the frame for a possible pre-roll.
+		this->InEvent = false;
+		if (this->Ring.empty())
+		{
+			++this->Dropped;
+			return;
+		}
+		Slot *slot(nullptr);
+		if (this->RingSize == this->Ring.size())
+		{
+			// Overwrite the oldest frame.
+			slot = &this->Ring[this->RingBegin];
+			this->RingBegin = (this->RingBegin + 1) % this->Ring.size();
+			++this->Dropped;
+		}
+		else
+			slot = &this->Ring[(this->RingBegin + this->RingSize++) % this->Ring.size()];
+		slot->Name = name;
+		slot->Mask.assign(mask.cbegin(), mask.cend());
+	}
+}
+
+#endif
@@ -0,0 +1,211 @@
+#if !defined(FAST_IMAGE_READER_H)
+#define FAST_IMAGE_READER_H
+
+// Standard C header files.
+#include <cstdio>
+#include <cstdlib>
+#include <cctype>
+
+// Standard C++ header files.
+#include <string>
+#include <vector>
+
+// Native readers for uncompressed BMP, binary PGM (P5) and binary PPM (P6) which write one gray channel straight
+// into the destination, without the 32bit BGRA intermediate of LoadImageFile(). The file is read into memory with one
+// call and parsed from there, so a caller which needs the bytes anyway (e.g. to fingerprint them) reads it only once.
+// The gray value is the blue channel, exactly as LoadImageFile() followed by BGRAtoGray_(), so both paths feed the
+// model identical data.
+// Supported: BMP with BI_RGB and 8 (palettized), 24 or 32 bits per pixel, top-down or bottom-up; PGM and PPM with
+// maxval 255. DecodeGrayImageFast() and LoadGrayImageFast() return false for anything else, and the caller falls back
+// to WIC.
+// Headers are validated, including the image size against FAST_IMAGE_MAX_DIMENSION and the data size, before
+// anything is written to the outputs.
+// Portable; only the file opening differs between Windows and POSIX.
+
+// Open a file with a wide path for binary reading, or for writing (truncating) if 'write' is set.
+inline std::FILE *OpenBinaryFile(const std::wstring &path, bool write = false)
+{
+#if defined(_WIN32)
+	std::FILE *file(nullptr);
+	return ::_wfopen_s(&file, path.c_str(), write ? L"wb" : L"rb") == 0 ? file : nullptr;
+#else
+	std::vector<char> narrow(path.size() * MB_CUR_MAX + 1);
+	if (std::wcstombs(narrow.data(), path.c_str(), narrow.size()) == static_cast<::size_t>(-1))
+		return nullptr;
+	return std::fopen(narrow.data(), write ? "wb" : "rb");
+#endif
+}
+
+// Larger images are rejected, which also keeps width * height * bytes per pixel far from overflowing.
+const unsigned int FAST_IMAGE_MAX_DIMENSION = 1 << 16;
+const unsigned long long FAST_IMAGE_MAX_PIXELS = 1ULL << 28;
+
+inline bool IsValidImageSize(unsigned int width, unsigned int height)
+{
+	return width != 0 && height != 0 && width <= FAST_IMAGE_MAX_DIMENSION && height <= FAST_IMAGE_MAX_DIMENSION &&
+		static_cast<unsigned long long>(width) * height <= FAST_IMAGE_MAX_PIXELS;
+}
+
+// Read a whole file into 'bytes'. Returns false if it can't be opened or read.
+inline bool ReadBinaryFile(const std::wstring &pathSrc, std::vector<unsigned char> &bytes)
+{
+	std::FILE *file = OpenBinaryFile(pathSrc);
+	if (file == nullptr)
+		return false;
+	bool succeeded(false);
+	if (std::fseek(file, 0, SEEK_END) == 0)
+	{
+		const long sz = std::ftell(file);
+		if (sz >= 0 && std::fseek(file, 0, SEEK_SET) == 0)
+		{
+			bytes.resize(static_cast<::size_t>(sz));
+			succeeded = std::fread(bytes.data(), 1, bytes.size(), file) == bytes.size();
+		}
+	}
+	std::fclose(file);
+	return succeeded;
+}
+
+// Little-endian fields of a BMP header.
+inline unsigned int ReadLE32(const unsigned char *p) { return p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<unsigned int>(p[3]) << 24); }
+inline unsigned int ReadLE16(const unsigned char *p) { return p[0] | (p[1] << 8); }
+
+// Next unsigned integer of a PNM header at 'p', skipping white space and comments. Advances 'p' past the value and
+// the one white space character which follows it.
+inline bool ReadPnmValue(const unsigned char *&p, const unsigned char *end, unsigned int &value)
+{
+	while (p != end && (*p == '#' || std::isspace(*p)))
+	{
+		if (*p == '#')
+			while (p != end && *p != '\n')
+				++p;
+		else
+			++p;
+	}
+	if (p == end || !std::isdigit(*p))
+		return false;
+	value = 0;
+	for (; p != end && std::isdigit(*p); ++p)
+	{
+		if (value > FAST_IMAGE_MAX_DIMENSION)
+			return false;	// Far beyond anything accepted; stop before it can overflow.
+		value = value * 10 + (*p - '0');
+	}
+	// Exactly one white space character separates the header from the pixel data.
+	if (p == end || !std::isspace(*p))
+		return false;
+	++p;
+	return true;
+}
+
+// Store row 'y' of the output from a row of 'bytesPerPixel' interleaved samples, taking the sample at 'offset'
+// (or the palette entry it indexes).
+template <typename T>
+void ConvertGrayRow(const unsigned char *row, ::size_t width, ::size_t bytesPerPixel, ::size_t offset, const unsigned char *palette, T *dst)
+{
+	if (palette != nullptr)
+		for (::size_t x = 0; x != width; ++x)
+			dst[x] = static_cast<T>(palette[row[x]]);
+	else
+		for (::size_t x = 0; x != width; ++x)
+			dst[x] = static_cast<T>(row[x * bytesPerPixel + offset]);
+}
+
+template <typename T>
+bool DecodeBmpGray(const unsigned char *data, ::size_t sz, std::vector<T> &dst, ::size_t &width, ::size_t &height)
+{
+	// BITMAPFILEHEADER (14 bytes) followed by at least a BITMAPINFOHEADER (40 bytes).
+	if (sz < 54)
+		return false;
+	const unsigned char *header = data;
+	const unsigned int offset_bits = ReadLE32(header + 10);
+	const unsigned int sz_info = ReadLE32(header + 14);
+	const unsigned int w = ReadLE32(header + 18);
+	// The height is signed; negative means top-down. Negated as unsigned, which is defined for 0x80000000 too.
+	const unsigned int h_field = ReadLE32(header + 22);
+	const bool bottom_up = (h_field & 0x80000000u) == 0;
+	const unsigned int h = bottom_up ? h_field : 0u - h_field;
+	const unsigned int bit_count = ReadLE16(header + 28);
+	const unsigned int compression = ReadLE32(header + 30);
+	unsigned int num_colors = ReadLE32(header + 46);
+	if (sz_info < 40 || sz_info > 1024 || !IsValidImageSize(w, h) || compression != 0 || (bit_count != 8 && bit_count != 24 && bit_count != 32))
+		return false;
+
+	// Blue channel of every palette entry (RGBQUAD: B, G, R, reserved).
+	unsigned char palette[256];
+	if (bit_count == 8)
+	{
+		if (num_colors == 0 || num_colors > 256)
+			num_colors = 256;
+		if (sz < 14 + sz_info || sz - (14 + sz_info) < num_colors * 4)
+			return false;
+		const unsigned char *quads = data + 14 + sz_info;
+		for (unsigned int n = 0; n != 256; ++n)
+			palette[n] = n < num_colors ? quads[n * 4] : 0;
+	}
+
+	const ::size_t bytes_per_pixel = bit_count / 8;
+	const ::size_t stride = (static_cast<::size_t>(w) * bit_count + 31) / 32 * 4;
+	if (offset_bits > sz || (sz - offset_bits) / stride < h)
+		return false;
+
+	dst.resize(static_cast<::size_t>(w) * h);
+	for (::size_t n = 0; n != h; ++n)
+	{
+		::size_t y = bottom_up ? h - 1 - n : n;
+		ConvertGrayRow(data + offset_bits + n * stride, w, bytes_per_pixel, 0, bit_count == 8 ? palette : nullptr, dst.data() + y * w);
+	}
+	width = w;
+	height = h;
+	return true;
+}
+
+// 'data' starts right after the magic number.
+template <typename T>
+bool DecodePnmGray(const unsigned char *data, ::size_t sz, bool color, std::vector<T> &dst, ::size_t &width, ::size_t &height)
+{
+	const unsigned char *p = data, *end = data + sz;
+	unsigned int w, h, max_value;
+	if (!ReadPnmValue(p, end, w) || !ReadPnmValue(p, end, h) || !ReadPnmValue(p, end, max_value))
+		return false;
+	if (!IsValidImageSize(w, h) || max_value != 255)
+		return false;	// 16bit samples go through WIC.
+
+	const ::size_t bytes_per_pixel = color ? 3 : 1;
+	const ::size_t stride = w * bytes_per_pixel;
+	if (static_cast<::size_t>(end - p) / stride < h)
+		return false;
+	dst.resize(static_cast<::size_t>(w) * h);
+	// PPM is stored as R, G, B; blue is the third sample.
+	for (::size_t y = 0; y != h; ++y)
+		ConvertGrayRow(p + y * stride, w, bytes_per_pixel, color ? 2 : 0, nullptr, dst.data() + y * w);
+	width = w;
+	height = h;
+	return true;
+}
+
+// Decode an uncompressed BMP, PGM or PPM file held in memory as a single gray channel into dst (float or
+// unsigned char). Returns false if it is not one of the supported formats or is truncated.
+// width and height are only written on success; dst may have been resized if decoding failed.
+template <typename T>
+bool DecodeGrayImageFast(const unsigned char *data, ::size_t sz, std::vector<T> &dst, ::size_t &width, ::size_t &height)
+{
+	if (sz < 2)
+		return false;
+	if (data[0] == 'B' && data[1] == 'M')
+		return DecodeBmpGray(data, sz, dst, width, height);
+	if (data[0] == 'P' && (data[1] == '5' || data[1] == '6'))
+		return DecodePnmGray(data + 2, sz - 2, data[1] == '6', dst, width, height);
+	return false;
+}
+
+// Load an uncompressed BMP, PGM or PPM file as a single gray channel into dst (float or unsigned char).
+// Returns false if the file can't be read, is not one of the supported formats or is truncated.
+// 'bytes' receives the file contents and can be kept between calls.
+template <typename T>
+bool LoadGrayImageFast(const std::wstring &pathSrc, std::vector<T> &dst, ::size_t &width, ::size_t &height, std::vector<unsigned char> &bytes)
+{
+	return ReadBinaryFile(pathSrc, bytes) && DecodeGrayImageFast(bytes.data(), bytes.size(), dst, width, height);
+}
+
+#endif
@@ -0,0 +1,79 @@
+#if !defined(FRAME_FINGERPRINT_H)
+#define FRAME_FINGERPRINT_H
+
+// Standard C header files.
+#include <cstring>
+#include <cmath>
+
+// Standard C++ header files.
+#include <vector>
+#include <algorithm>
+
+// Cheap checks for frozen or stalled cameras, which deliver runs of identical or nearly identical frames.
+
+const unsigned long long FNV1A_OFFSET_BASIS = 14695981039346656037ULL;
+const unsigned long long FNV1A_PRIME = 1099511628211ULL;
+
+// FNV-1a over 64bit words instead of bytes, which is 8 times fewer multiplications; the tail is hashed byte by byte.
+// Continue a hash by passing the previous result as 'hash'.
+inline unsigned long long Fnv1a64(const unsigned char *data, ::size_t sz, unsigned long long hash = FNV1A_OFFSET_BASIS)
+{
+	::size_t n = 0;
+	for (; n + 8 <= sz; n += 8)
+	{
+		unsigned long long word;
+		std::memcpy(&word, data + n, 8);
+		hash = (hash ^ word) * FNV1A_PRIME;
+	}
+	for (; n != sz; ++n)
+		hash = (hash ^ data[n]) * FNV1A_PRIME;
+	return hash;
+}
+
+// Fingerprint of an input file, including its size, from the bytes read for decoding. An identical file is found
+// before it is decoded, and detecting it costs no extra file I/O.
+inline unsigned long long FingerprintBytes(const unsigned char *data, ::size_t sz)
+{
+	unsigned long long hash = Fnv1a64(data, sz);
+	unsigned long long sz_data = sz;
+	return Fnv1a64(reinterpret_cast<const unsigned char *>(&sz_data), sizeof(sz_data), hash);
+}
+
+// True if two frames of width x height pixels differ by less than 'threshold' gray levels on average in every 16x16 tile.
+// A whole-frame average would let a small object through: a 60x60 object on a 1080p frame moves the mean by a
+// fraction of a gray level. Per tile, it moves at least one tile by most of its contrast, while sensor noise still
+// averages out. Stops at the first tile at or above the threshold.
+inline bool IsNearDuplicate(const float *a, const float *b, ::size_t width, ::size_t height, float threshold)
+{
+	const ::size_t TILE(16);
+	if (width == 0 || height == 0)
+		return false;
+	const ::size_t num_tiles_x = (width + TILE - 1) / TILE;
+	std::vector<float> sums(num_tiles_x);
+	for (::size_t y_begin = 0; y_begin < height; y_begin += TILE)
+	{
+		const ::size_t y_end = std::min(y_begin + TILE, height);
+		std::fill(sums.begin(), sums.end(), 0.0f);
+		for (::size_t y = y_begin; y != y_end; ++y)
+		{
+			const float *row_a = a + y * width, *row_b = b + y * width;
+			for (::size_t t = 0; t != num_tiles_x; ++t)
+			{
+				const ::size_t x_end = std::min((t + 1) * TILE, width);
+				float sum(0.0f);
+				for (::size_t x = t * TILE; x != x_end; ++x)
+					sum += std::fabs(row_a[x] - row_b[x]);
+				sums[t] += sum;
+			}
+		}
+		for (::size_t t = 0; t != num_tiles_x; ++t)
+		{
+			const ::size_t num_pixels = (std::min((t + 1) * TILE, width) - t * TILE) * (y_end - y_begin);
+			if (sums[t] >= threshold * num_pixels)
+				return false;
+		}
+	}
+	return true;
+}
+
+#endif
@@ -0,0 +1,193 @@
+#if !defined(FRAME_MEMORY_H)
+#define FRAME_MEMORY_H
+
+// Standard C++ header files.
+#include <vector>
+#include <algorithm>
+
+#if defined(_WIN32)
+// Windows header files.
+#include <Windows.h>
+#else
+// POSIX header files.
+#include <sys/mman.h>
+#endif
+
+// Kind of pages backing a LargePageBuffer.
+enum class PageKind
+{
+	Normal,
+	Transparent,	// Normal allocation the kernel was asked to back with huge pages (Linux transparent huge pages).
+	Large			// Explicit large pages (MEM_LARGE_PAGES on Windows, hugetlbfs on Linux).
+};
+
+inline const wchar_t *PageKindName(PageKind kind)
+{
+	switch (kind)
+	{
+	case PageKind::Transparent: return L"transparent huge pages";
+	case PageKind::Large: return L"large pages";
+	default: return L"normal pages";
+	}
+}
+
+#if defined(_WIN32)
+// Large pages need SeLockMemoryPrivilege, which has to be granted to the user by policy and then enabled in the
+// process token. Returns false if it is not granted.
+inline bool EnableLockMemoryPrivilege(void)
+{
+	HANDLE token(nullptr);
+	if (!::OpenProcessToken(::GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &token))
+		return false;
+	::TOKEN_PRIVILEGES privileges = {};
+	privileges.PrivilegeCount = 1;
+	privileges.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+	bool succeeded = ::LookupPrivilegeValueW(nullptr, SE_LOCK_MEMORY_NAME, &privileges.Privileges[0].Luid) &&
+		::AdjustTokenPrivileges(token, FALSE, &privileges, 0, nullptr, nullptr) && ::GetLastError() != ERROR_NOT_ALL_ASSIGNED;
+	::CloseHandle(token);
+	return succeeded;
+}
+#endif
+
+// Page-aligned memory which is backed by huge pages if requested and possible, and by normal pages otherwise.
+// Huge pages cut the TLB misses of streaming over hundreds of MB of frames. Explicit large pages are tried first;
+// on Linux, a normal allocation is then marked for transparent huge pages. The memory is zero-initialized.
+class LargePageBuffer
+{
+public:
+	LargePageBuffer(void) = default;
+	LargePageBuffer(const LargePageBuffer &) = delete;
+	LargePageBuffer &operator=(const LargePageBuffer &) = delete;
+	~LargePageBuffer(void) { this->Free(); }
+
+	// Returns false only if even normal pages can't be allocated.
+	bool Allocate(::size_t sz, bool hugePages);
+	void Free(void);
+
+	void *Data(void) const { return this->Memory; }
+	::size_t Size(void) const { return this->Sz; }
+	PageKind Kind(void) const { return this->Pages; }
+
+protected:
+	void *Memory = nullptr;
+	::size_t Sz = 0;
+	PageKind Pages = PageKind::Normal;
+};
+
+inline bool LargePageBuffer::Allocate(::size_t sz, bool hugePages)
+{
+	this->Free();
+	if (sz == 0)
+		return false;
+#if defined(_WIN32)
+	const ::size_t sz_large = ::GetLargePageMinimum();
+	if (hugePages && sz_large != 0 && EnableLockMemoryPrivilege())
+	{
+		::size_t sz_rounded = (sz + sz_large - 1) / sz_large * sz_large;
+		this->Memory = ::VirtualAlloc(nullptr, sz_rounded, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+		if (this->Memory != nullptr)
+		{
+			this->Sz = sz_rounded;
+			this->Pages = PageKind::Large;
+			return true;
+		}
+	}
+	this->Memory = ::VirtualAlloc(nullptr, sz, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+	if (this->Memory == nullptr)
+		return false;
+	this->Sz = sz;
+	this->Pages = PageKind::Normal;
+	return true;
+#else
+	const ::size_t SZ_HUGE(2 * 1024 * 1024);
+	::size_t sz_rounded = (sz + SZ_HUGE - 1) / SZ_HUGE * SZ_HUGE;
+	void *memory(MAP_FAILED);
+#if defined(MAP_HUGETLB)
+	if (hugePages)
+		memory = ::mmap(nullptr, sz_rounded, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+#endif
+	this->Pages = PageKind::Large;
+	if (memory == MAP_FAILED)
+	{
+		memory = ::mmap(nullptr, sz_rounded, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (memory == MAP_FAILED)
+			return false;
+		this->Pages = PageKind::Normal;
+#if defined(MADV_HUGEPAGE)
+		if (hugePages && ::madvise(memory, sz_rounded, MADV_HUGEPAGE) == 0)
+			this->Pages = PageKind::Transparent;
+#endif
+	}
+	this->Memory = memory;
+	this->Sz = sz_rounded;
+	return true;
+#endif
+}
+
+inline void LargePageBuffer::Free(void)
+{
+	if (this->Memory == nullptr)
+		return;
+#if defined(_WIN32)
+	::VirtualFree(this->Memory, 0, MEM_RELEASE);
+#else
+	::munmap(this->Memory, this->Sz);
+#endif
+	this->Memory = nullptr;
+	this->Sz = 0;
+	this->Pages = PageKind::Normal;
+}
+
+// History of the last maxLength frames plus the mean, standard deviation and mask planes of the model, all in one
+// LargePageBuffer. Works like the std::deque buffer of Test1(), without allocating per frame: Reserve() returns the
+// memory of the next frame (the oldest one once the history is full), and Push() makes it the newest.
+class FrameHistory
+{
+public:
+	// Returns false if the memory can't be allocated.
+	bool Allocate(::size_t frameSize, ::size_t maxLength, bool hugePages);
+
+	float *Reserve(void) { return this->FrameAt(this->Count == this->MaxLength ? this->Oldest : (this->Oldest + this->Count) % this->MaxLength); }
+	void Push(void);
+
+	// Frames oldest first, as ComputeModelTiled() takes them.
+	const std::vector<const float *> &Frames(void) const { return this->Ordered; }
+	::size_t Size(void) const { return this->Count; }
+	::size_t FrameSize(void) const { return this->Sz; }
+	float *Mean(void) { return this->FrameAt(this->MaxLength); }
+	float *Std(void) { return this->FrameAt(this->MaxLength + 1); }
+	unsigned char *Mask(void) { return reinterpret_cast<unsigned char *>(this->FrameAt(this->MaxLength + 2)); }
+	PageKind Kind(void) const { return this->Memory.Kind(); }
+
+protected:
+	float *FrameAt(::size_t n) { return static_cast<float *>(this->Memory.Data()) + n * this->Stride; }
+
+	LargePageBuffer Memory;
+	::size_t Sz = 0, Stride = 0, MaxLength = 0;
+	::size_t Oldest = 0, Count = 0;
+	std::vector<const float *> Ordered;
+};
+
+inline bool FrameHistory::Allocate(::size_t frameSize, ::size_t maxLength, bool hugePages)
+{
+	// Planes start on cache lines; the mask plane takes a float plane's worth of memory for simplicity.
+	this->Sz = frameSize;
+	this->Stride = (frameSize + 15) / 16 * 16;
+	this->MaxLength = std::max<::size_t>(1, maxLength);
+	this->Oldest = this->Count = 0;
+	this->Ordered.clear();
+	return this->Memory.Allocate((this->MaxLength + 3) * this->Stride * sizeof(float), hugePages);
+}
+
+inline void FrameHistory::Push(void)
+{
+	if (this->Count == this->MaxLength)
+		this->Oldest = (this->Oldest + 1) % this->MaxLength;
+	else
+		++this->Count;
+	this->Ordered.clear();
+	for (::size_t n = 0; n != this->Count; ++n)
+		this->Ordered.push_back(this->FrameAt((this->Oldest + n) % this->MaxLength));
+}
+
+#endif
@@ -0,0 +1,106 @@
+#if !defined(GRAY_STREAM_WRITER_H)
+#define GRAY_STREAM_WRITER_H
+
+// Standard C header files.
+#include <cstdio>
+
+// Standard C++ header files.
+#include <string>
+#include <vector>
+#include <iostream>
+
+// Custom header files.
+#include "fast_image_reader.h"	// OpenBinaryFile()
+
+enum class StreamFormat
+{
+	Y4M,		// YUV4MPEG2 with the "mono" color space; plays in ffplay/mpv and converts with ffmpeg.
+	RawGray		// Headerless 8bit frames back to back; frame n starts at n * width * height.
+};
+
+// Appends 8bit gray frames (masks or gray images) to one file instead of writing one BMP per frame.
+// The header is written once on the first frame, and frames go through a large stdio buffer, so a frame costs
+// one memcpy into the buffer and a sequential write every few frames. All frames must have the same size.
+class GrayStreamWriter
+{
+public:
+	GrayStreamWriter(void) = default;
+	~GrayStreamWriter(void) { this->Close(); }
+	GrayStreamWriter(const GrayStreamWriter &) = delete;
+	GrayStreamWriter &operator=(const GrayStreamWriter &) = delete;
+
+	bool Open(const std::wstring &pathDst, StreamFormat format, ::size_t width, ::size_t height, unsigned int fps = 30);
+	bool WriteFrame(const unsigned char *data, ::size_t sz);
+	void Close(void);
+
+	bool IsOpen(void) const { return this->File != nullptr; }
+	::size_t NumFrames(void) const { return this->Frames; }
+
+protected:
+	std::FILE *File = nullptr;
+	StreamFormat Format = StreamFormat::Y4M;
+	::size_t Width = 0, Height = 0, Frames = 0;
+	::size_t Rejected = 0, RejectedSize = 0;	// Frames of another size, and the size of the current run of them.
+	std::wstring Path;
+	std::vector<char> Buffer;
+};
+
+inline bool GrayStreamWriter::Open(const std::wstring &pathDst, StreamFormat format, ::size_t width, ::size_t height, unsigned int fps)
+{
+	this->Close();
+	this->File = OpenBinaryFile(pathDst, true);
+	if (this->File == nullptr)
+	{
+		std::wclog << L"Failed to create a stream file " << pathDst << std::endl;
+		return false;
+	}
+	this->Buffer.resize(4 * 1024 * 1024);
+	std::setvbuf(this->File, this->Buffer.data(), _IOFBF, this->Buffer.size());
+	this->Format = format;
+	this->Width = width;
+	this->Height = height;
+	this->Frames = 0;
+	this->Rejected = 0;
+	this->RejectedSize = 0;
+	this->Path = pathDst;
+
+	if (format == StreamFormat::Y4M)
+		std::fprintf(this->File, "YUV4MPEG2 W%u H%u F%u:1 Ip A1:1 Cmono\n",
+			static_cast<unsigned int>(width), static_cast<unsigned int>(height), fps);
+	return std::ferror(this->File) == 0;
+}
+
+inline bool GrayStreamWriter::WriteFrame(const unsigned char *data, ::size_t sz)
+{
+	if (this->File == nullptr)
+		return false;
+	if (sz != this->Width * this->Height)
+	{
+		// Only the first frame after a resolution change is logged; Close() reports the total.
+		if (sz != this->RejectedSize)
+			std::wclog << L"Skipping frames of " << sz << L" pixels in a " << this->Width << L"x" << this->Height << L" stream." << std::endl;
+		this->RejectedSize = sz;
+		++this->Rejected;
+		return false;
+	}
+	this->RejectedSize = 0;
+	if (this->Format == StreamFormat::Y4M && std::fputs("FRAME\n", this->File) < 0)
+		return false;
+	if (std::fwrite(data, 1, sz, this->File) != sz)
+		return false;
+	++this->Frames;
+	return true;
+}
+
+inline void GrayStreamWriter::Close(void)
+{
+	if (this->File != nullptr)
+	{
+		if (this->Rejected != 0)
+			std::wclog << this->Rejected << L" frames of another size were left out of " << this->Path << std::endl;
+		std::fclose(this->File);
+		this->File = nullptr;
+	}
+}
+
+#endif
@@ -0,0 +1,303 @@
+#if !defined(KERNEL_ENGINE_H)
+#define KERNEL_ENGINE_H
+
+// Standard C++ header files.
+#include <vector>
+#include <deque>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+
+#if defined(_WIN32)
+// Windows header files.
+#include <Windows.h>
+#else
+// POSIX header files.
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+// Custom header files.
+#include "pixel_kernels.h"
+#include "precision_clock.h"
+
+class WorkerPool;
+
+// How ComputeModelTiled() splits a frame.
+struct TileConfig
+{
+	::size_t TileSize = 0;			// Pixels per tile. 0 processes the whole frame as one tile.
+	unsigned int NumThreads = 1;	// Including the calling thread.
+	// Worker thread n (1 to NumThreads - 1) is pinned to Cores[n % Cores.size()]. Core 0 of the list is meant for the
+	// calling thread, which the caller pins itself with PinCurrentThread(). Empty leaves the threads to the scheduler.
+	std::vector<unsigned int> Cores;
+	// Persistent workers to run on. Null starts NumThreads - 1 threads per call. With a pool, at most its number of
+	// workers take part, and they keep the cores the pool pinned them to, so Cores is not used.
+	WorkerPool *Pool = nullptr;
+};
+
+// Restrict the calling thread to one logical processor, so it keeps its caches and doesn't migrate in the middle
+// of a frame. Returns false if the core doesn't exist or the system refuses.
+inline bool PinCurrentThread(unsigned int core)
+{
+#if defined(_WIN32)
+	if (core >= sizeof(DWORD_PTR) * 8)
+		return false;
+	return ::SetThreadAffinityMask(::GetCurrentThread(), static_cast<DWORD_PTR>(1) << core) != 0;
+#else
+	if (core >= CPU_SETSIZE)
+		return false;
+	cpu_set_t cpus;
+	CPU_ZERO(&cpus);
+	CPU_SET(core, &cpus);
+	return ::pthread_setaffinity_np(::pthread_self(), sizeof(cpus), &cpus) == 0;
+#endif
+}
+
+// Worker threads which live as long as the pool, so a frame doesn't pay for starting and joining threads, and
+// pinned workers stay on their cores with warm caches. Worker n (1 to numWorkers) is pinned to cores[n % cores.size()]
+// once when it starts, as TileConfig::Cores does for the threads of one call. Run() must not be called from several
+// threads at once.
+class WorkerPool
+{
+public:
+	WorkerPool(unsigned int numWorkers, const std::vector<unsigned int> &cores = std::vector<unsigned int>());
+	WorkerPool(const WorkerPool &) = delete;
+	WorkerPool &operator=(const WorkerPool &) = delete;
+	~WorkerPool(void);
+
+	unsigned int NumWorkers(void) const { return static_cast<unsigned int>(this->Workers.size()); }
+	// Run job() on the calling thread and on up to numWorkers workers at the same time. Returns once all are done.
+	void Run(unsigned int numWorkers, const std::function<void(void)> &job);
+
+protected:
+	void Loop(unsigned int index);
+
+	std::vector<std::thread> Workers;
+	std::mutex Mutex;
+	std::condition_variable Wake, Done;
+	const std::function<void(void)> *Job = nullptr;
+	unsigned long long Generation = 0;	// Incremented for every job.
+	unsigned int NumActive = 0;			// Workers 0 to NumActive - 1 take part in the current job.
+	unsigned int NumRunning = 0;		// Of those, the ones which haven't finished it yet.
+	bool Stopping = false;
+};
+
+inline WorkerPool::WorkerPool(unsigned int numWorkers, const std::vector<unsigned int> &cores)
+{
+	for (unsigned int n = 0; n != numWorkers; ++n)
+		this->Workers.push_back(std::thread([this, cores, n]()
+		{
+			if (!cores.empty())
+				PinCurrentThread(cores[(n + 1) % cores.size()]);
+			this->Loop(n);
+		}));
+}
+
+inline WorkerPool::~WorkerPool(void)
+{
+	{
+		std::lock_guard<std::mutex> lock(this->Mutex);
+		this->Stopping = true;
+	}
+	this->Wake.notify_all();
+	for (auto &worker : this->Workers)
+		worker.join();
+}
+
+inline void WorkerPool::Run(unsigned int numWorkers, const std::function<void(void)> &job)
+{
+	numWorkers = std::min(numWorkers, this->NumWorkers());
+	if (numWorkers != 0)
+	{
+		{
+			std::lock_guard<std::mutex> lock(this->Mutex);
+			this->Job = &job;
+			this->NumActive = this->NumRunning = numWorkers;
+			++this->Generation;
+		}
+		this->Wake.notify_all();
+	}
+	job();
+	if (numWorkers != 0)
+	{
+		std::unique_lock<std::mutex> lock(this->Mutex);
+		this->Done.wait(lock, [this]() { return this->NumRunning == 0; });
+	}
+}
+
+inline void WorkerPool::Loop(unsigned int index)
+{
+	unsigned long long generation(0);
+	for (;;)
+	{
+		const std::function<void(void)> *job;
+		{
+			std::unique_lock<std::mutex> lock(this->Mutex);
+			this->Wake.wait(lock, [&]() { return this->Stopping || (this->Generation != generation && index < this->NumActive); });
+			if (this->Stopping)
+				return;
+			generation = this->Generation;
+			job = this->Job;
+		}
+		(*job)();
+		std::lock_guard<std::mutex> lock(this->Mutex);
+		if (--this->NumRunning == 0)
+			this->Done.notify_one();
+	}
+}
+
+// Point config at 'pool', first replacing it with a larger one pinned to 'cores' if it has fewer workers than
+// config.NumThreads needs. Call before every frame; threads are only started when the thread count grows.
+inline void AttachWorkerPool(TileConfig &config, std::unique_ptr<WorkerPool> &pool, const std::vector<unsigned int> &cores)
+{
+	const unsigned int num_workers = config.NumThreads > 1 ? config.NumThreads - 1 : 0;
+	if (num_workers != 0 && (!pool || pool->NumWorkers() < num_workers))
+		pool.reset(new WorkerPool(num_workers, cores));
+	config.Pool = pool.get();
+}
+
+// Call fn(begin, end) for every tile of [0, sz). Tiles are handed out from a shared counter, so a thread which
+// finishes early takes the next tile. The calling thread works as one of the threads; the others come from
+// config.Pool if it is set.
+inline void RunTiled(const TileConfig &config, ::size_t sz, const std::function<void(::size_t, ::size_t)> &fn)
+{
+	const ::size_t sz_tile = config.TileSize == 0 ? sz : config.TileSize;
+	const ::size_t num_tiles = sz_tile == 0 ? 0 : (sz + sz_tile - 1) / sz_tile;
+	std::atomic<::size_t> next(0);
+	auto work = [&]()
+	{
+		for (::size_t tile = next++; tile < num_tiles; tile = next++)
+		{
+			::size_t begin = tile * sz_tile;
+			fn(begin, std::min(begin + sz_tile, sz));
+		}
+	};
+
+	const unsigned int num_threads = static_cast<unsigned int>(std::min<::size_t>(std::max(1u, config.NumThreads), num_tiles));
+	if (config.Pool != nullptr)
+	{
+		config.Pool->Run(num_threads > 1 ? num_threads - 1 : 0, work);
+		return;
+	}
+	std::vector<std::thread> workers;
+	for (unsigned int n = 1; n < num_threads; ++n)
+		workers.push_back(std::thread([&config, &work, n]()
+		{
+			if (!config.Cores.empty())
+				PinCurrentThread(config.Cores[n % config.Cores.size()]);
+			work();
+		}));
+	work();
+	for (auto &worker : workers)
+		worker.join();
+}
+
+// Mean and standard deviation over all frames of 'frames' and the mask of the newest frame, for pixels [begin, end).
+// Performs exactly the arithmetic of ComputeMean(), ComputeStd() and Mark(), fused per tile so that the tile's
+// statistics stay in cache between the three steps. Returns the number of foreground pixels in the tile.
+inline ::size_t ComputeModelSpan(const PixelKernels &kernels, const std::vector<const float *> &frames, ::size_t begin, ::size_t end,
+	float th, float *mean, float *std, unsigned char *mask)
+{
+	const ::size_t sz = end - begin;
+	const float NUM_FRMS = static_cast<float>(frames.size());
+
+	std::fill(mean + begin, mean + end, 0.0f);
+	for (auto frame : frames)
+		kernels.Accumulate(mean + begin, frame + begin, sz);
+	kernels.Divide(mean + begin, NUM_FRMS, sz);
+
+	std::fill(std + begin, std + end, 0.0f);
+	for (auto frame : frames)
+		kernels.AccumulateDiffSq(std + begin, frame + begin, mean + begin, sz);
+	kernels.DivideSqrt(std + begin, NUM_FRMS, sz);
+
+	return kernels.Mark(frames.back() + begin, mean + begin, std + begin, th, mask + begin, sz);
+}
+
+// Same as below for frames of sz pixels anywhere in memory, oldest first, and preallocated outputs.
+inline ::size_t ComputeModelTiled(const PixelKernels &kernels, const TileConfig &config, const std::vector<const float *> &frames,
+	::size_t sz, float th, float *mean, float *std, unsigned char *mask)
+{
+	std::atomic<::size_t> count(0);
+	RunTiled(config, sz, [&](::size_t begin, ::size_t end)
+	{
+		count += ComputeModelSpan(kernels, frames, begin, end, th, mean, std, mask);
+	});
+	return count;
+}
+
+// Same results as ComputeMean(), ComputeStd() and Mark() on the newest frame of 'buffer', computed tile by tile
+// with the given kernels and threads. Returns the number of foreground pixels.
+inline ::size_t ComputeModelTiled(const PixelKernels &kernels, const TileConfig &config, const std::deque<std::vector<float>> &buffer,
+	float th, std::vector<float> &mean, std::vector<float> &std, std::vector<unsigned char> &mask)
+{
+	const ::size_t sz = buffer.back().size();
+	mean.resize(sz);
+	std.resize(sz);
+	mask.resize(sz);
+	std::vector<const float *> frames;
+	for (const auto &frame : buffer)
+		frames.push_back(frame.data());
+	return ComputeModelTiled(kernels, config, frames, sz, th, mean.data(), std.data(), mask.data());
+}
+
+// Time ComputeModelTiled() for every combination of candidate tile sizes and thread counts on the given frames,
+// and return the fastest. Each candidate runs a few times and keeps its best time, so one preempted run doesn't
+// decide the result. Meant to be called once on the first full buffer; the choice is then kept.
+inline TileConfig AutoTuneTiles(const PixelKernels &kernels, const std::vector<const float *> &frames, ::size_t sz, float th)
+{
+	const ::size_t NUM_REPEAT(3);
+	const ::size_t TILE_SIZES[] = { 0, 256 * 1024, 64 * 1024, 16 * 1024 };
+	std::vector<unsigned int> thread_counts;
+	const unsigned int max_threads = std::max(1u, std::thread::hardware_concurrency());
+	for (unsigned int n = 1; n < max_threads; n *= 2)
+		thread_counts.push_back(n);
+	thread_counts.push_back(max_threads);
+
+	std::vector<float> mean(sz), std(sz);
+	std::vector<unsigned char> mask(sz);
+	TileConfig best;
+	double best_sec(-1.0);
+	for (auto sz_tile : TILE_SIZES)
+		for (auto num_threads : thread_counts)
+		{
+			// Threads need at least one tile each.
+			if (num_threads > 1 && (sz_tile == 0 || sz / sz_tile < num_threads))
+				continue;
+			TileConfig config;
+			config.TileSize = sz_tile;
+			config.NumThreads = num_threads;
+			double sec(-1.0);
+			for (::size_t n = 0; n != NUM_REPEAT; ++n)
+			{
+				auto t_start = PrecisionClock::now();
+				ComputeModelTiled(kernels, config, frames, sz, th, mean.data(), std.data(), mask.data());
+				double elapsed = std::chrono::duration<double>(PrecisionClock::now() - t_start).count();
+				if (sec < 0.0 || elapsed < sec)
+					sec = elapsed;
+			}
+			if (best_sec < 0.0 || sec < best_sec)
+			{
+				best = config;
+				best_sec = sec;
+			}
+		}
+	return best;
+}
+
+// Same as above on the frames of 'buffer'.
+inline TileConfig AutoTuneTiles(const PixelKernels &kernels, const std::deque<std::vector<float>> &buffer, float th)
+{
+	std::vector<const float *> frames;
+	for (const auto &frame : buffer)
+		frames.push_back(frame.data());
+	return AutoTuneTiles(kernels, frames, buffer.back().size(), th);
+}
+
+#endif
@@ -0,0 +1,247 @@
+#if !defined(MASK_MORPHOLOGY_H)
+#define MASK_MORPHOLOGY_H
+
+// Standard C++ header files.
+#include <vector>
+#include <algorithm>
+
+// SSE2 intrinsics; available on every Win32 and x64 target.
+#include <emmintrin.h>
+
+// Morphological cleanup of byte masks (0x00 / 0xFF) with rectangular structuring elements.
+// Erosion and dilation are separable into a horizontal and a vertical 1D pass.
+// The vertical pass uses the van Herk/Gil-Werman algorithm: the padded column is split into blocks of k rows,
+// a running min (max) is taken forward and backward inside every block, and each output is the min (max) of
+// one backward and one forward value. That is three comparisons per pixel, whatever k is, and every step
+// works on whole rows, so it is vectorized with SSE2 over 16 columns at a time.
+// The running min (max) is a serial dependency along a row, so the horizontal pass transposes strips of 16 rows
+// into tiles of 16 byte columns and runs the same vertical pass on them; every pass stays O(1) in k and works
+// on 16 rows at once.
+// Pixels outside the image are treated as the identity of the operation (0xFF for erosion, 0x00 for
+// dilation), so the borders are not eroded or dilated by the outside.
+class MaskMorphology
+{
+public:
+	void Erode(const std::vector<unsigned char> &src, std::vector<unsigned char> &dst, ::size_t width, ::size_t height, ::size_t kernelWidth, ::size_t kernelHeight)
+	{
+		this->Filter<MinOp>(src, dst, width, height, kernelWidth, kernelHeight);
+	}
+	void Dilate(const std::vector<unsigned char> &src, std::vector<unsigned char> &dst, ::size_t width, ::size_t height, ::size_t kernelWidth, ::size_t kernelHeight)
+	{
+		this->Filter<MaxOp>(src, dst, width, height, kernelWidth, kernelHeight);
+	}
+	// Removes foreground speckles smaller than the kernel.
+	void Open(const std::vector<unsigned char> &src, std::vector<unsigned char> &dst, ::size_t width, ::size_t height, ::size_t kernelWidth, ::size_t kernelHeight)
+	{
+		this->Filter<MinOp>(src, this->Opened, width, height, kernelWidth, kernelHeight);
+		this->Filter<MaxOp>(this->Opened, dst, width, height, kernelWidth, kernelHeight);
+	}
+	// Fills background holes smaller than the kernel.
+	void Close(const std::vector<unsigned char> &src, std::vector<unsigned char> &dst, ::size_t width, ::size_t height, ::size_t kernelWidth, ::size_t kernelHeight)
+	{
+		this->Filter<MaxOp>(src, this->Opened, width, height, kernelWidth, kernelHeight);
+		this->Filter<MinOp>(this->Opened, dst, width, height, kernelWidth, kernelHeight);
+	}
+
+protected:
+	struct MinOp
+	{
+		static unsigned char Identity(void) { return 0xFF; }
+		static unsigned char Apply(unsigned char a, unsigned char b) { return a < b ? a : b; }
+		static __m128i Apply(__m128i a, __m128i b) { return _mm_min_epu8(a, b); }
+	};
+	struct MaxOp
+	{
+		static unsigned char Identity(void) { return 0x00; }
+		static unsigned char Apply(unsigned char a, unsigned char b) { return a > b ? a : b; }
+		static __m128i Apply(__m128i a, __m128i b) { return _mm_max_epu8(a, b); }
+	};
+
+	// 16x16 byte transpose in place. Each step interleaves row i with row i + 8, which rotates the 8-bit
+	// (row, column) index by one bit; four steps swap row and column.
+	// Written out so that the vectors stay in registers without relying on loop unrolling.
+	static void Interleave16(const __m128i a[16], __m128i b[16])
+	{
+		b[0] = _mm_unpacklo_epi8(a[0], a[8]);	b[1] = _mm_unpackhi_epi8(a[0], a[8]);
+		b[2] = _mm_unpacklo_epi8(a[1], a[9]);	b[3] = _mm_unpackhi_epi8(a[1], a[9]);
+		b[4] = _mm_unpacklo_epi8(a[2], a[10]);	b[5] = _mm_unpackhi_epi8(a[2], a[10]);
+		b[6] = _mm_unpacklo_epi8(a[3], a[11]);	b[7] = _mm_unpackhi_epi8(a[3], a[11]);
+		b[8] = _mm_unpacklo_epi8(a[4], a[12]);	b[9] = _mm_unpackhi_epi8(a[4], a[12]);
+		b[10] = _mm_unpacklo_epi8(a[5], a[13]);	b[11] = _mm_unpackhi_epi8(a[5], a[13]);
+		b[12] = _mm_unpacklo_epi8(a[6], a[14]);	b[13] = _mm_unpackhi_epi8(a[6], a[14]);
+		b[14] = _mm_unpacklo_epi8(a[7], a[15]);	b[15] = _mm_unpackhi_epi8(a[7], a[15]);
+	}
+	static void Transpose16x16(__m128i v[16])
+	{
+		__m128i t[16];
+		Interleave16(v, t);
+		Interleave16(t, v);
+		Interleave16(v, t);
+		Interleave16(t, v);
+	}
+	// Transpose 16 rows of width bytes into width rows of 16 bytes, and back.
+	static void TransposeStrip(const unsigned char *const rows[16], unsigned char *dst, ::size_t width)
+	{
+		__m128i v[16];
+		::size_t x = 0;
+		for (; x + 16 <= width; x += 16)
+		{
+			for (int j = 0; j != 16; ++j)
+				v[j] = _mm_loadu_si128(reinterpret_cast<const __m128i *>(rows[j] + x));
+			Transpose16x16(v);
+			for (int j = 0; j != 16; ++j)
+				_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + (x + j) * 16), v[j]);
+		}
+		for (; x != width; ++x)
+			for (int j = 0; j != 16; ++j)
+				dst[x * 16 + j] = rows[j][x];
+	}
+	static void UntransposeStrip(const unsigned char *src, unsigned char *const rows[16], ::size_t width)
+	{
+		__m128i v[16];
+		::size_t x = 0;
+		for (; x + 16 <= width; x += 16)
+		{
+			for (int j = 0; j != 16; ++j)
+				v[j] = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + (x + j) * 16));
+			Transpose16x16(v);
+			for (int j = 0; j != 16; ++j)
+				_mm_storeu_si128(reinterpret_cast<__m128i *>(rows[j] + x), v[j]);
+		}
+		for (; x != width; ++x)
+			for (int j = 0; j != 16; ++j)
+				rows[j][x] = src[x * 16 + j];
+	}
+
+	// dst[i] = OP(a[i], b[i]) for i in [0, n). dst may be a, and b may overlap it at a higher address.
+	template <class OP>
+	static void ApplyRange(unsigned char *dst, const unsigned char *a, const unsigned char *b, ::size_t n)
+	{
+		::size_t i = 0;
+		for (; i + 16 <= n; i += 16)
+		{
+			__m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i *>(a + i));
+			__m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + i));
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), OP::Apply(va, vb));
+		}
+		for (; i != n; ++i)
+			dst[i] = OP::Apply(a[i], b[i]);
+	}
+
+	template <class OP>
+	void Filter(const std::vector<unsigned char> &src, std::vector<unsigned char> &dst, ::size_t width, ::size_t height, ::size_t kernelWidth, ::size_t kernelHeight);
+	template <class OP>
+	void FilterRows(const unsigned char *src, unsigned char *dst, ::size_t width, ::size_t height, ::size_t k);
+	template <class OP>
+	void FilterColumns(const unsigned char *src, unsigned char *dst, ::size_t width, ::size_t height, ::size_t k);
+
+	// Scratch buffers, kept between calls so that per-frame use doesn't allocate.
+	std::vector<unsigned char> Forward, Backward, Padding, Horizontal, Opened;
+	std::vector<unsigned char> IdentityRow, DiscardRow, Strip, FilteredStrip;
+};
+
+template <class OP>
+void MaskMorphology::Filter(const std::vector<unsigned char> &src, std::vector<unsigned char> &dst, ::size_t width, ::size_t height, ::size_t kernelWidth, ::size_t kernelHeight)
+{
+	// Horizontal pass into a scratch plane, then vertical pass into dst, so dst may be the same vector as src.
+	this->Horizontal.resize(width * height);
+	if (kernelWidth > 1)
+		this->FilterRows<OP>(src.data(), this->Horizontal.data(), width, height, kernelWidth);
+	else
+		std::copy(src.cbegin(), src.cbegin() + width * height, this->Horizontal.begin());
+
+	dst.resize(width * height);
+	if (kernelHeight > 1)
+		this->FilterColumns<OP>(this->Horizontal.data(), dst.data(), width, height, kernelHeight);
+	else
+		std::copy(this->Horizontal.cbegin(), this->Horizontal.cend(), dst.begin());
+}
+
+template <class OP>
+void MaskMorphology::FilterRows(const unsigned char *src, unsigned char *dst, ::size_t width, ::size_t height, ::size_t k)
+{
+	// Each strip of 16 rows becomes a padded column of 16 byte vectors, one per x, and gets the same van Herk pass as
+	// FilterColumns: the backward running min (max) of every block is stored, and the forward one is kept in a register
+	// while the output is written. Rows past the bottom of the image read the identity and are written to a row
+	// nobody reads.
+	const ::size_t r = k / 2;
+	const ::size_t len = (width + k - 1 + k - 1) / k * k;
+	this->IdentityRow.assign(width, OP::Identity());
+	this->DiscardRow.resize(width);
+	this->Strip.assign(len * 16, OP::Identity());
+	this->Backward.resize(len * 16);
+	this->FilteredStrip.resize(width * 16);
+	unsigned char *f = this->Strip.data(), *h = this->Backward.data(), *out = this->FilteredStrip.data();
+	auto load = [](const unsigned char *p) { return _mm_loadu_si128(reinterpret_cast<const __m128i *>(p)); };
+	auto store = [](unsigned char *p, __m128i v) { _mm_storeu_si128(reinterpret_cast<__m128i *>(p), v); };
+	const unsigned char *rows_src[16];
+	unsigned char *rows_dst[16];
+
+	for (::size_t y = 0; y < height; y += 16)
+	{
+		for (::size_t j = 0; j != 16; ++j)
+		{
+			rows_src[j] = y + j < height ? src + (y + j) * width : this->IdentityRow.data();
+			rows_dst[j] = y + j < height ? dst + (y + j) * width : this->DiscardRow.data();
+		}
+		// Padded positions [0, r) and [r + width, len) keep the identity.
+		TransposeStrip(rows_src, f + r * 16, width);
+
+		for (::size_t b = 0; b != len; b += k)
+		{
+			__m128i acc = load(f + (b + k - 1) * 16);
+			store(h + (b + k - 1) * 16, acc);
+			for (::size_t i = b + k - 1; i != b; --i)
+			{
+				acc = OP::Apply(acc, load(f + (i - 1) * 16));
+				store(h + (i - 1) * 16, acc);
+			}
+		}
+		// Output x covers padded positions [x, x + k - 1]; the forward value at i = x + k - 1 restarts at every block.
+		for (::size_t b = 0; b < width + k - 1; b += k)
+		{
+			const ::size_t end = std::min(b + k, width + k - 1);
+			__m128i acc = load(f + b * 16);
+			for (::size_t i = b; i != end; ++i)
+			{
+				acc = OP::Apply(acc, load(f + i * 16));
+				if (i + 1 >= k)
+					store(out + (i + 1 - k) * 16, OP::Apply(load(h + (i + 1 - k) * 16), acc));
+			}
+		}
+		UntransposeStrip(out, rows_dst, width);
+	}
+}
+
+template <class OP>
+void MaskMorphology::FilterColumns(const unsigned char *src, unsigned char *dst, ::size_t width, ::size_t height, ::size_t k)
+{
+	// Output y covers padded rows [y, y + k - 1]. The padded column is split into blocks of k rows; every element
+	// is a whole row, so the running min (max) runs over 16 columns at once.
+	const ::size_t r = k / 2;
+	const ::size_t len = (height + k - 1 + k - 1) / k * k;
+	this->Padding.assign(width, OP::Identity());
+	this->Forward.resize(len * width);
+	this->Backward.resize(len * width);
+	const unsigned char *identity = this->Padding.data();
+	unsigned char *g = this->Forward.data(), *h = this->Backward.data();
+
+	// Row i of the padded column. Rows outside the image are the identity row.
+	auto row = [=](::size_t i) { return (i < r || i >= r + height) ? identity : src + (i - r) * width; };
+	// dst_row = OP(a, b) over the whole row.
+	auto apply_row = [=](unsigned char *dst_row, const unsigned char *a, const unsigned char *b) { ApplyRange<OP>(dst_row, a, b, width); };
+
+	for (::size_t b = 0; b != len; b += k)
+	{
+		std::copy(row(b), row(b) + width, g + b * width);
+		for (::size_t i = b + 1; i != b + k; ++i)
+			apply_row(g + i * width, g + (i - 1) * width, row(i));
+		std::copy(row(b + k - 1), row(b + k - 1) + width, h + (b + k - 1) * width);
+		for (::size_t i = b + k - 1; i != b; --i)
+			apply_row(h + (i - 1) * width, h + i * width, row(i - 1));
+	}
+	for (::size_t y = 0; y != height; ++y)
+		apply_row(dst + y * width, h + y * width, g + (y + k - 1) * width);
+}
+
+#endif
@@ -0,0 +1,162 @@
+#if !defined(MODEL_SNAPSHOT_H)
+#define MODEL_SNAPSHOT_H
+
+// Standard C++ header files.
+#include <string>
+#include <deque>
+#include <vector>
+#include <cstring>
+#include <iostream>
+#include <algorithm>
+
+// Windows header files.
+#include <Windows.h>
+
+// Binary snapshot of a background model.
+// File layout: [ModelSnapshotHeader][BufferLength x (Width * Height) float], oldest frame first.
+// Bump MODEL_SNAPSHOT_VERSION whenever the layout changes; older files are then rejected and the
+// model starts with an empty buffer.
+const unsigned int MODEL_SNAPSHOT_VERSION = 3;
+// Larger headers are rejected before any size arithmetic, so a corrupt file can't overflow it.
+const unsigned long long MODEL_SNAPSHOT_MAX_DIMENSION = 1 << 16;
+const unsigned long long MODEL_SNAPSHOT_MAX_LENGTH = 1 << 16;
+const char MODEL_SNAPSHOT_MAGIC[8] = { 'B', 'G', 'S', 'N', 'A', 'P', '\0', '\0' };
+
+struct ModelSnapshotHeader
+{
+	char Magic[8];
+	unsigned int Version;
+	unsigned int HeaderSize;			// sizeof(ModelSnapshotHeader) at the time of writing.
+	unsigned long long Width;
+	unsigned long long Height;
+	unsigned long long FrameCount;		// Number of input frames consumed before the snapshot, skipped ones included.
+	unsigned long long BufferLength;	// Number of frames stored after the header.
+	unsigned long long MaxBufferLength;	// Buffer length of the model which wrote the snapshot.
+	wchar_t Source[MAX_PATH];			// Input the frames came from, e.g. the folder; truncated and null-terminated.
+	wchar_t LastFile[MAX_PATH];			// Last input file consumed; a resumed run continues after it.
+};
+
+// Write the buffered frames, the frame counter and the input position to a snapshot file, tagged with the input
+// they came from.
+// The data is written to a temporary file first and then renamed, so a crash while writing never
+// leaves a truncated snapshot behind.
+inline bool SaveModelSnapshot(const std::wstring &pathDst, const std::wstring &source, const std::deque<std::vector<float>> &buffer,
+	const std::wstring &lastFile, ::size_t width, ::size_t height, ::size_t frameCount, ::size_t maxBufferLength)
+{
+	ModelSnapshotHeader header = {};
+	std::memcpy(header.Magic, MODEL_SNAPSHOT_MAGIC, sizeof(header.Magic));
+	header.Version = MODEL_SNAPSHOT_VERSION;
+	header.HeaderSize = sizeof(ModelSnapshotHeader);
+	header.Width = width;
+	header.Height = height;
+	header.FrameCount = frameCount;
+	header.BufferLength = buffer.size();
+	header.MaxBufferLength = maxBufferLength;
+	source.copy(header.Source, MAX_PATH - 1);
+	lastFile.copy(header.LastFile, MAX_PATH - 1);
+
+	std::wstring path_temp = pathDst + L".tmp";
+	HANDLE hFile = ::CreateFileW(path_temp.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS,
+		FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (hFile == INVALID_HANDLE_VALUE)
+	{
+		std::wclog << L"Failed to create a snapshot file " << path_temp << std::endl;
+		return false;
+	}
+
+	bool succeeded(true);
+	unsigned long written(0);
+	if (!::WriteFile(hFile, &header, sizeof(header), &written, nullptr) || written != sizeof(header))
+		succeeded = false;
+	const unsigned long sz_frame = static_cast<unsigned long>(width * height * sizeof(float));
+	for (auto it = buffer.cbegin(), it_end = buffer.cend(); succeeded && it != it_end; ++it)
+	{
+		if (it->size() != width * height)
+			succeeded = false;
+		else if (!::WriteFile(hFile, it->data(), sz_frame, &written, nullptr) || written != sz_frame)
+			succeeded = false;
+	}
+	::CloseHandle(hFile);
+
+	if (succeeded)
+		succeeded = ::MoveFileExW(path_temp.c_str(), pathDst.c_str(), MOVEFILE_REPLACE_EXISTING) ? true : false;
+	if (!succeeded)
+	{
+		std::wclog << L"Failed to write a snapshot file " << pathDst << std::endl;
+		::DeleteFileW(path_temp.c_str());
+	}
+	return succeeded;
+}
+
+// Map a snapshot file into memory and restore the buffered frames, the frame counter and the input position from it.
+// If the snapshot was written with a longer buffer than maxBufferLength, only the latest frames are kept.
+// A snapshot of another source is rejected; frames of an unrelated scene would corrupt the first masks.
+// Returns false without touching the outputs if the file doesn't exist or is not a valid snapshot.
+inline bool LoadModelSnapshot(const std::wstring &pathSrc, const std::wstring &source, std::deque<std::vector<float>> &buffer,
+	std::wstring &lastFile, ::size_t &width, ::size_t &height, ::size_t &frameCount, ::size_t maxBufferLength)
+{
+	HANDLE hFile = ::CreateFileW(pathSrc.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (hFile == INVALID_HANDLE_VALUE)
+		return false;	// No snapshot yet; start from an empty buffer.
+
+	bool succeeded(false);
+	::LARGE_INTEGER sz_file;
+	if (::GetFileSizeEx(hFile, &sz_file) && sz_file.QuadPart >= static_cast<long long>(sizeof(ModelSnapshotHeader)))
+	{
+		HANDLE hMapping = ::CreateFileMappingW(hFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (hMapping != nullptr)
+		{
+			const void *view = ::MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0);
+			if (view != nullptr)
+			{
+				const ModelSnapshotHeader *header = static_cast<const ModelSnapshotHeader *>(view);
+				const std::wstring stored(header->Source, std::find(header->Source, header->Source + MAX_PATH, L'\0'));
+				if (std::memcmp(header->Magic, MODEL_SNAPSHOT_MAGIC, sizeof(header->Magic)) != 0)
+					std::wclog << pathSrc << L" is not a background model snapshot." << std::endl;
+				else if (header->Version != MODEL_SNAPSHOT_VERSION || header->HeaderSize != sizeof(ModelSnapshotHeader))
+					std::wclog << L"Unsupported snapshot version " << header->Version << L" in " << pathSrc << std::endl;
+				else if (header->Width > MODEL_SNAPSHOT_MAX_DIMENSION || header->Height > MODEL_SNAPSHOT_MAX_DIMENSION ||
+					header->BufferLength > MODEL_SNAPSHOT_MAX_LENGTH)
+					std::wclog << L"Snapshot " << pathSrc << L" has an invalid size." << std::endl;
+				else if (stored != source.substr(0, MAX_PATH - 1))
+					std::wclog << L"Snapshot " << pathSrc << L" belongs to " << stored << L", not " << source
+						<< L"; starting with an empty buffer." << std::endl;
+				else if (static_cast<unsigned long long>(sz_file.QuadPart) !=
+					sizeof(ModelSnapshotHeader) + header->BufferLength * header->Width * header->Height * sizeof(float))
+					std::wclog << L"Snapshot " << pathSrc << L" is truncated." << std::endl;
+				else
+				{
+					// Skip the oldest frames if the snapshot holds more frames than the current buffer length.
+					const unsigned long long sz_frame = header->Width * header->Height;
+					const float *frames = reinterpret_cast<const float *>(header + 1);
+					unsigned long long skip = header->BufferLength > maxBufferLength ? header->BufferLength - maxBufferLength : 0;
+					buffer.clear();
+					for (auto n = skip; n != header->BufferLength; ++n)
+					{
+						const float *frame = frames + n * sz_frame;
+						buffer.push_back(std::vector<float>(frame, frame + sz_frame));
+					}
+					width = static_cast<::size_t>(header->Width);
+					height = static_cast<::size_t>(header->Height);
+					frameCount = static_cast<::size_t>(header->FrameCount);
+					lastFile.assign(header->LastFile, std::find(header->LastFile, header->LastFile + MAX_PATH, L'\0'));
+					succeeded = true;
+				}
+				::UnmapViewOfFile(view);
+			}
+			else
+				std::wclog << L"Failed to map a snapshot file " << pathSrc << std::endl;
+			::CloseHandle(hMapping);
+		}
+		else
+			std::wclog << L"Failed to create a file mapping for " << pathSrc << std::endl;
+	}
+	else
+		std::wclog << L"Snapshot " << pathSrc << L" is too small." << std::endl;
+
+	::CloseHandle(hFile);
+	return succeeded;
+}
+
+#endif
@@ -0,0 +1,111 @@
+#if !defined(MULTI_WINDOW_STATS_H)
+#define MULTI_WINDOW_STATS_H
+
+// Standard C++ header files.
+#include <vector>
+#include <deque>
+#include <algorithm>
+#include <cmath>
+
+// Mean and standard deviation over several window lengths served from one shared history buffer.
+// Every frame is stored once. Each window keeps running sums of the values and of the squared values,
+// which are updated when a frame enters and when it falls off that window's boundary, so the cost per frame
+// is two additions and two subtractions per pixel per window regardless of the window length.
+// The sums are kept in double; gray values are small integers (or thirds of them), so the error stays far
+// below what Mark() can notice even after millions of frames.
+class MultiWindowStats
+{
+public:
+	MultiWindowStats(const std::vector<::size_t> &windowLengths) : Lengths(windowLengths),
+		MaxLength(windowLengths.empty() ? 0 : *std::max_element(windowLengths.cbegin(), windowLengths.cend())) {}
+
+	// Add a new frame. All windows are reset if the frame size changes.
+	void Push(std::vector<float> &&data);
+
+	::size_t NumWindows(void) const { return this->Lengths.size(); }
+	::size_t WindowLength(::size_t window) const { return this->Lengths[window]; }
+	// Number of frames currently covered by a window; less than its length until the history is filled.
+	::size_t Count(::size_t window) const { return std::min(this->History.size(), this->Lengths[window]); }
+	const std::vector<float> &Latest(void) const { return this->History.back(); }
+
+	// Same results as ComputeMean() and ComputeStd() over the last WindowLength(window) frames.
+	void GetMean(::size_t window, std::vector<float> &mean) const;
+	void GetStd(::size_t window, std::vector<float> &std) const;
+
+protected:
+	std::vector<::size_t> Lengths;
+	::size_t MaxLength;
+	std::deque<std::vector<float>> History;
+	std::vector<std::vector<double>> Sums, SumsSq;	// Per window.
+};
+
+inline void MultiWindowStats::Push(std::vector<float> &&data)
+{
+	if (this->Lengths.empty())
+		return;
+
+	// (Re)initialize the sums for the first frame or a new resolution.
+	if (this->History.empty() || this->History.back().size() != data.size())
+	{
+		this->History.clear();
+		this->Sums.assign(this->Lengths.size(), std::vector<double>(data.size(), 0.0));
+		this->SumsSq.assign(this->Lengths.size(), std::vector<double>(data.size(), 0.0));
+	}
+
+	// The history temporarily holds MaxLength + 1 frames, so the longest window can still see the frame it evicts.
+	this->History.push_back(std::move(data));
+	const std::vector<float> &added = this->History.back();
+	const ::size_t sz = added.size(), len_history = this->History.size();
+
+	for (::size_t w = 0; w != this->Lengths.size(); ++w)
+	{
+		double *sum = this->Sums[w].data(), *sum_sq = this->SumsSq[w].data();
+		if (len_history > this->Lengths[w])
+		{
+			// Add the new frame and evict the one which just crossed this window's boundary.
+			const std::vector<float> &removed = this->History[len_history - 1 - this->Lengths[w]];
+			for (::size_t n = 0; n != sz; ++n)
+			{
+				double a = added[n], r = removed[n];
+				sum[n] += a - r;
+				sum_sq[n] += a * a - r * r;
+			}
+		}
+		else
+			for (::size_t n = 0; n != sz; ++n)
+			{
+				double a = added[n];
+				sum[n] += a;
+				sum_sq[n] += a * a;
+			}
+	}
+
+	if (this->History.size() > this->MaxLength)
+		this->History.pop_front();
+}
+
+inline void MultiWindowStats::GetMean(::size_t window, std::vector<float> &mean) const
+{
+	const std::vector<double> &sum = this->Sums[window];
+	if (mean.size() != sum.size())
+		mean.resize(sum.size());
+	const double NUM_FRMS = static_cast<double>(this->Count(window));
+	std::transform(sum.cbegin(), sum.cend(), mean.begin(), [NUM_FRMS](double value) { return static_cast<float>(value / NUM_FRMS); });
+}
+
+inline void MultiWindowStats::GetStd(::size_t window, std::vector<float> &std) const
+{
+	const std::vector<double> &sum = this->Sums[window], &sum_sq = this->SumsSq[window];
+	if (std.size() != sum.size())
+		std.resize(sum.size());
+	const double NUM_FRMS = static_cast<double>(this->Count(window));
+	for (::size_t n = 0, sz = sum.size(); n != sz; ++n)
+	{
+		// E[x^2] - E[x]^2 computed from the exact sums rather than the rounded mean.
+		double m = sum[n] / NUM_FRMS;
+		double var = sum_sq[n] / NUM_FRMS - m * m;
+		std[n] = static_cast<float>(std::sqrt(var > 0.0 ? var : 0.0));
+	}
+}
+
+#endif
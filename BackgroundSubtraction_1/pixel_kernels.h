@@ -0,0 +1,481 @@
+#if !defined(PIXEL_KERNELS_H)
+#define PIXEL_KERNELS_H
+
+// Standard C++ header files.
+#include <cmath>
+
+// Intrinsics.
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#include <x86intrin.h>
+#endif
+#include <immintrin.h>
+
+// MSVC accepts every intrinsic regardless of /arch; GCC and Clang need the target on each function.
+#if defined(__GNUC__)
+#define KERNEL_TARGET_SSE41 __attribute__((target("sse4.1")))
+#define KERNEL_TARGET_AVX2 __attribute__((target("avx2")))
+#define KERNEL_TARGET_AVX512 __attribute__((target("avx512f")))
+#else
+#define KERNEL_TARGET_SSE41
+#define KERNEL_TARGET_AVX2
+#define KERNEL_TARGET_AVX512
+#endif
+
+// A fused multiply-add rounds once, so contracting "acc += d * d" would break bit-exactness with the scalar reference.
+// MSVC only contracts with /arch:AVX2 and /fp:fast, which this project doesn't use.
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC push_options
+#pragma GCC optimize("fp-contract=off")
+#endif
+
+// AVX-512 intrinsics are available from VS2017 15.3 and in every GCC/Clang we build with.
+#if defined(__GNUC__) || (defined(_MSC_VER) && _MSC_VER >= 1911)
+#define PIXEL_KERNELS_AVX512
+#endif
+
+// Pointer-based versions of the per-pixel routines in backgroundSubtraction_1.cpp.
+// Every variant performs the same IEEE operations in the same order as the scalar one (sums are accumulated
+// frame by frame, then divided; no reciprocal approximations), so all variants produce bit-identical results.
+struct PixelKernels
+{
+	const wchar_t *Name;
+	// dst[n] = blue channel of src[4 n .. 4 n + 3], as BGRAtoGray_().
+	void (*BgraToGray)(const unsigned char *src, float *dst, ::size_t sz);
+	// acc[n] += src[n]
+	void (*Accumulate)(float *acc, const float *src, ::size_t sz);
+	// acc[n] += (src[n] - mean[n])^2
+	void (*AccumulateDiffSq)(float *acc, const float *src, const float *mean, ::size_t sz);
+	// data[n] /= divisor
+	void (*Divide)(float *data, float divisor, ::size_t sz);
+	// data[n] = sqrt(data[n] / divisor)
+	void (*DivideSqrt)(float *data, float divisor, ::size_t sz);
+	// dst[n] = |data[n] - mean[n]| / std[n] > th ? 0xFF : 0x00, as Mark(). Returns the number of 0xFF.
+	::size_t (*Mark)(const float *data, const float *mean, const float *std, float th, unsigned char *dst, ::size_t sz);
+	// dst[3 n .. 3 n + 2] = src[n], as GrayToBGR().
+	void (*GrayToBgr)(const unsigned char *src, unsigned char *dst, ::size_t sz);
+};
+
+enum class CpuLevel { Scalar, Sse41, Avx2, Avx512 };
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// CPU feature detection.
+
+inline void CpuId(int info[4], int leaf, int subLeaf)
+{
+#if defined(_MSC_VER)
+	::__cpuidex(info, leaf, subLeaf);
+#else
+	unsigned int a, b, c, d;
+	__cpuid_count(leaf, subLeaf, a, b, c, d);
+	info[0] = a; info[1] = b; info[2] = c; info[3] = d;
+#endif
+}
+
+// XCR0; tells which register states the OS saves on context switch.
+inline unsigned long long XGetBv(void)
+{
+#if defined(_MSC_VER)
+	return ::_xgetbv(0);
+#else
+	unsigned int lo, hi;
+	__asm__ volatile ("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+	return (static_cast<unsigned long long>(hi) << 32) | lo;
+#endif
+}
+
+// The best instruction set supported by both the CPU and the OS.
+inline CpuLevel DetectCpuLevel(void)
+{
+	int info[4];
+	CpuId(info, 0, 0);
+	const int max_leaf = info[0];
+	if (max_leaf < 1)
+		return CpuLevel::Scalar;
+
+	CpuId(info, 1, 0);
+	const bool sse41 = (info[2] & (1 << 19)) != 0;
+	const bool osxsave = (info[2] & (1 << 27)) != 0;
+	const bool avx = (info[2] & (1 << 28)) != 0;
+	if (!sse41)
+		return CpuLevel::Scalar;
+	if (!osxsave || !avx || max_leaf < 7)
+		return CpuLevel::Sse41;
+
+	const unsigned long long xcr0 = XGetBv();
+	if ((xcr0 & 0x06) != 0x06)		// XMM and YMM state.
+		return CpuLevel::Sse41;
+	CpuId(info, 7, 0);
+	const bool avx2 = (info[1] & (1 << 5)) != 0;
+	const bool avx512f = (info[1] & (1 << 16)) != 0;
+	if (!avx2)
+		return CpuLevel::Sse41;
+#if defined(PIXEL_KERNELS_AVX512)
+	if (avx512f && (xcr0 & 0xE6) == 0xE6)	// Plus opmask and ZMM state.
+		return CpuLevel::Avx512;
+#endif
+	return CpuLevel::Avx2;
+}
+
+inline const wchar_t *CpuLevelName(CpuLevel level)
+{
+	switch (level)
+	{
+	case CpuLevel::Sse41: return L"SSE4.1";
+	case CpuLevel::Avx2: return L"AVX2";
+	case CpuLevel::Avx512: return L"AVX-512";
+	default: return L"Scalar";
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Scalar kernels; also used for the remainder of every SIMD loop.
+
+inline void BgraToGrayScalar(const unsigned char *src, float *dst, ::size_t sz)
+{
+	for (::size_t n = 0; n != sz; ++n)
+		dst[n] = src[4 * n];
+}
+
+inline void AccumulateScalar(float *acc, const float *src, ::size_t sz)
+{
+	for (::size_t n = 0; n != sz; ++n)
+		acc[n] += src[n];
+}
+
+inline void AccumulateDiffSqScalar(float *acc, const float *src, const float *mean, ::size_t sz)
+{
+	for (::size_t n = 0; n != sz; ++n)
+	{
+		float temp = src[n] - mean[n];
+		acc[n] += temp * temp;
+	}
+}
+
+inline void DivideScalar(float *data, float divisor, ::size_t sz)
+{
+	for (::size_t n = 0; n != sz; ++n)
+		data[n] /= divisor;
+}
+
+inline void DivideSqrtScalar(float *data, float divisor, ::size_t sz)
+{
+	for (::size_t n = 0; n != sz; ++n)
+		data[n] = std::sqrt(data[n] / divisor);
+}
+
+inline ::size_t MarkScalar(const float *data, const float *mean, const float *std, float th, unsigned char *dst, ::size_t sz)
+{
+	::size_t count(0);
+	for (::size_t n = 0; n != sz; ++n)
+	{
+		bool marked = (std::abs(data[n] - mean[n]) / std[n]) > th;
+		dst[n] = marked ? 0xFF : 0x00;
+		count += marked;
+	}
+	return count;
+}
+
+inline void GrayToBgrScalar(const unsigned char *src, unsigned char *dst, ::size_t sz)
+{
+	for (::size_t n = 0; n != sz; ++n, dst += 3)
+		dst[0] = dst[1] = dst[2] = src[n];
+}
+
+// Number of set bits in a compare mask.
+inline unsigned int CountMaskBits(unsigned int mask)
+{
+	unsigned int count(0);
+	for (; mask != 0; mask &= mask - 1)
+		++count;
+	return count;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// SSE4.1 kernels.
+
+KERNEL_TARGET_SSE41 inline void BgraToGraySse41(const unsigned char *src, float *dst, ::size_t sz)
+{
+	const __m128i BLUE = _mm_set1_epi32(0xFF);
+	::size_t n = 0;
+	for (; n + 4 <= sz; n += 4)
+	{
+		__m128i bgra = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + 4 * n));
+		_mm_storeu_ps(dst + n, _mm_cvtepi32_ps(_mm_and_si128(bgra, BLUE)));
+	}
+	BgraToGrayScalar(src + 4 * n, dst + n, sz - n);
+}
+
+KERNEL_TARGET_SSE41 inline void AccumulateSse41(float *acc, const float *src, ::size_t sz)
+{
+	::size_t n = 0;
+	for (; n + 4 <= sz; n += 4)
+		_mm_storeu_ps(acc + n, _mm_add_ps(_mm_loadu_ps(acc + n), _mm_loadu_ps(src + n)));
+	AccumulateScalar(acc + n, src + n, sz - n);
+}
+
+KERNEL_TARGET_SSE41 inline void AccumulateDiffSqSse41(float *acc, const float *src, const float *mean, ::size_t sz)
+{
+	::size_t n = 0;
+	for (; n + 4 <= sz; n += 4)
+	{
+		__m128 temp = _mm_sub_ps(_mm_loadu_ps(src + n), _mm_loadu_ps(mean + n));
+		_mm_storeu_ps(acc + n, _mm_add_ps(_mm_loadu_ps(acc + n), _mm_mul_ps(temp, temp)));
+	}
+	AccumulateDiffSqScalar(acc + n, src + n, mean + n, sz - n);
+}
+
+KERNEL_TARGET_SSE41 inline void DivideSse41(float *data, float divisor, ::size_t sz)
+{
+	const __m128 DIVISOR = _mm_set1_ps(divisor);
+	::size_t n = 0;
+	for (; n + 4 <= sz; n += 4)
+		_mm_storeu_ps(data + n, _mm_div_ps(_mm_loadu_ps(data + n), DIVISOR));
+	DivideScalar(data + n, divisor, sz - n);
+}
+
+KERNEL_TARGET_SSE41 inline void DivideSqrtSse41(float *data, float divisor, ::size_t sz)
+{
+	const __m128 DIVISOR = _mm_set1_ps(divisor);
+	::size_t n = 0;
+	for (; n + 4 <= sz; n += 4)
+		_mm_storeu_ps(data + n, _mm_sqrt_ps(_mm_div_ps(_mm_loadu_ps(data + n), DIVISOR)));
+	DivideSqrtScalar(data + n, divisor, sz - n);
+}
+
+// |data - mean| / std > th for 4 elements; all-ones lanes where marked. NaN compares false, as in Mark().
+KERNEL_TARGET_SSE41 inline __m128 MarkSse41Step(const float *data, const float *mean, const float *std, __m128 th)
+{
+	const __m128 ABS_MASK = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+	__m128 diff = _mm_and_ps(_mm_sub_ps(_mm_loadu_ps(data), _mm_loadu_ps(mean)), ABS_MASK);
+	return _mm_cmpgt_ps(_mm_div_ps(diff, _mm_loadu_ps(std)), th);
+}
+
+KERNEL_TARGET_SSE41 inline ::size_t MarkSse41(const float *data, const float *mean, const float *std, float th, unsigned char *dst, ::size_t sz)
+{
+	const __m128 TH = _mm_set1_ps(th);
+	::size_t count(0), n(0);
+	for (; n + 16 <= sz; n += 16)
+	{
+		__m128 m0 = MarkSse41Step(data + n, mean + n, std + n, TH);
+		__m128 m1 = MarkSse41Step(data + n + 4, mean + n + 4, std + n + 4, TH);
+		__m128 m2 = MarkSse41Step(data + n + 8, mean + n + 8, std + n + 8, TH);
+		__m128 m3 = MarkSse41Step(data + n + 12, mean + n + 12, std + n + 12, TH);
+		// Saturating packs keep -1 as -1 (0xFF) and 0 as 0.
+		__m128i lo = _mm_packs_epi32(_mm_castps_si128(m0), _mm_castps_si128(m1));
+		__m128i hi = _mm_packs_epi32(_mm_castps_si128(m2), _mm_castps_si128(m3));
+		__m128i bytes = _mm_packs_epi16(lo, hi);
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + n), bytes);
+		count += CountMaskBits(static_cast<unsigned int>(_mm_movemask_epi8(bytes)));
+	}
+	return count + MarkScalar(data + n, mean + n, std + n, th, dst + n, sz - n);
+}
+
+KERNEL_TARGET_SSE41 inline void GrayToBgrSse41(const unsigned char *src, unsigned char *dst, ::size_t sz)
+{
+	// 16 gray bytes become 48 BGR bytes.
+	const __m128i SHUFFLE0 = _mm_setr_epi8(0, 0, 0, 1, 1, 1, 2, 2, 2, 3, 3, 3, 4, 4, 4, 5);
+	const __m128i SHUFFLE1 = _mm_setr_epi8(5, 5, 6, 6, 6, 7, 7, 7, 8, 8, 8, 9, 9, 9, 10, 10);
+	const __m128i SHUFFLE2 = _mm_setr_epi8(10, 11, 11, 11, 12, 12, 12, 13, 13, 13, 14, 14, 14, 15, 15, 15);
+	::size_t n = 0;
+	for (; n + 16 <= sz; n += 16)
+	{
+		__m128i gray = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + n));
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + 3 * n), _mm_shuffle_epi8(gray, SHUFFLE0));
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + 3 * n + 16), _mm_shuffle_epi8(gray, SHUFFLE1));
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + 3 * n + 32), _mm_shuffle_epi8(gray, SHUFFLE2));
+	}
+	GrayToBgrScalar(src + n, dst + 3 * n, sz - n);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// AVX2 kernels.
+
+KERNEL_TARGET_AVX2 inline void BgraToGrayAvx2(const unsigned char *src, float *dst, ::size_t sz)
+{
+	const __m256i BLUE = _mm256_set1_epi32(0xFF);
+	::size_t n = 0;
+	for (; n + 8 <= sz; n += 8)
+	{
+		__m256i bgra = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + 4 * n));
+		_mm256_storeu_ps(dst + n, _mm256_cvtepi32_ps(_mm256_and_si256(bgra, BLUE)));
+	}
+	BgraToGrayScalar(src + 4 * n, dst + n, sz - n);
+}
+
+KERNEL_TARGET_AVX2 inline void AccumulateAvx2(float *acc, const float *src, ::size_t sz)
+{
+	::size_t n = 0;
+	for (; n + 8 <= sz; n += 8)
+		_mm256_storeu_ps(acc + n, _mm256_add_ps(_mm256_loadu_ps(acc + n), _mm256_loadu_ps(src + n)));
+	AccumulateScalar(acc + n, src + n, sz - n);
+}
+
+KERNEL_TARGET_AVX2 inline void AccumulateDiffSqAvx2(float *acc, const float *src, const float *mean, ::size_t sz)
+{
+	::size_t n = 0;
+	for (; n + 8 <= sz; n += 8)
+	{
+		__m256 temp = _mm256_sub_ps(_mm256_loadu_ps(src + n), _mm256_loadu_ps(mean + n));
+		_mm256_storeu_ps(acc + n, _mm256_add_ps(_mm256_loadu_ps(acc + n), _mm256_mul_ps(temp, temp)));
+	}
+	AccumulateDiffSqScalar(acc + n, src + n, mean + n, sz - n);
+}
+
+KERNEL_TARGET_AVX2 inline void DivideAvx2(float *data, float divisor, ::size_t sz)
+{
+	const __m256 DIVISOR = _mm256_set1_ps(divisor);
+	::size_t n = 0;
+	for (; n + 8 <= sz; n += 8)
+		_mm256_storeu_ps(data + n, _mm256_div_ps(_mm256_loadu_ps(data + n), DIVISOR));
+	DivideScalar(data + n, divisor, sz - n);
+}
+
+KERNEL_TARGET_AVX2 inline void DivideSqrtAvx2(float *data, float divisor, ::size_t sz)
+{
+	const __m256 DIVISOR = _mm256_set1_ps(divisor);
+	::size_t n = 0;
+	for (; n + 8 <= sz; n += 8)
+		_mm256_storeu_ps(data + n, _mm256_sqrt_ps(_mm256_div_ps(_mm256_loadu_ps(data + n), DIVISOR)));
+	DivideSqrtScalar(data + n, divisor, sz - n);
+}
+
+KERNEL_TARGET_AVX2 inline __m256 MarkAvx2Step(const float *data, const float *mean, const float *std, __m256 th)
+{
+	const __m256 ABS_MASK = _mm256_castsi256_ps(_mm256_set1_epi32(0x7FFFFFFF));
+	__m256 diff = _mm256_and_ps(_mm256_sub_ps(_mm256_loadu_ps(data), _mm256_loadu_ps(mean)), ABS_MASK);
+	return _mm256_cmp_ps(_mm256_div_ps(diff, _mm256_loadu_ps(std)), th, _CMP_GT_OQ);
+}
+
+KERNEL_TARGET_AVX2 inline ::size_t MarkAvx2(const float *data, const float *mean, const float *std, float th, unsigned char *dst, ::size_t sz)
+{
+	const __m256 TH = _mm256_set1_ps(th);
+	::size_t count(0), n(0);
+	for (; n + 16 <= sz; n += 16)
+	{
+		__m256i m0 = _mm256_castps_si256(MarkAvx2Step(data + n, mean + n, std + n, TH));
+		__m256i m1 = _mm256_castps_si256(MarkAvx2Step(data + n + 8, mean + n + 8, std + n + 8, TH));
+		// Pack within 128-bit halves so the bytes stay in order.
+		__m128i lo = _mm_packs_epi32(_mm256_castsi256_si128(m0), _mm256_extracti128_si256(m0, 1));
+		__m128i hi = _mm_packs_epi32(_mm256_castsi256_si128(m1), _mm256_extracti128_si256(m1, 1));
+		__m128i bytes = _mm_packs_epi16(lo, hi);
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + n), bytes);
+		count += CountMaskBits(static_cast<unsigned int>(_mm_movemask_epi8(bytes)));
+	}
+	return count + MarkScalar(data + n, mean + n, std + n, th, dst + n, sz - n);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// AVX-512 kernels.
+
+#if defined(PIXEL_KERNELS_AVX512)
+KERNEL_TARGET_AVX512 inline void BgraToGrayAvx512(const unsigned char *src, float *dst, ::size_t sz)
+{
+	const __m512i BLUE = _mm512_set1_epi32(0xFF);
+	::size_t n = 0;
+	for (; n + 16 <= sz; n += 16)
+	{
+		__m512i bgra = _mm512_loadu_si512(src + 4 * n);
+		_mm512_storeu_ps(dst + n, _mm512_cvtepi32_ps(_mm512_and_si512(bgra, BLUE)));
+	}
+	BgraToGrayScalar(src + 4 * n, dst + n, sz - n);
+}
+
+KERNEL_TARGET_AVX512 inline void AccumulateAvx512(float *acc, const float *src, ::size_t sz)
+{
+	::size_t n = 0;
+	for (; n + 16 <= sz; n += 16)
+		_mm512_storeu_ps(acc + n, _mm512_add_ps(_mm512_loadu_ps(acc + n), _mm512_loadu_ps(src + n)));
+	AccumulateScalar(acc + n, src + n, sz - n);
+}
+
+KERNEL_TARGET_AVX512 inline void AccumulateDiffSqAvx512(float *acc, const float *src, const float *mean, ::size_t sz)
+{
+	::size_t n = 0;
+	for (; n + 16 <= sz; n += 16)
+	{
+		__m512 temp = _mm512_sub_ps(_mm512_loadu_ps(src + n), _mm512_loadu_ps(mean + n));
+		_mm512_storeu_ps(acc + n, _mm512_add_ps(_mm512_loadu_ps(acc + n), _mm512_mul_ps(temp, temp)));
+	}
+	AccumulateDiffSqScalar(acc + n, src + n, mean + n, sz - n);
+}
+
+KERNEL_TARGET_AVX512 inline void DivideAvx512(float *data, float divisor, ::size_t sz)
+{
+	const __m512 DIVISOR = _mm512_set1_ps(divisor);
+	::size_t n = 0;
+	for (; n + 16 <= sz; n += 16)
+		_mm512_storeu_ps(data + n, _mm512_div_ps(_mm512_loadu_ps(data + n), DIVISOR));
+	DivideScalar(data + n, divisor, sz - n);
+}
+
+KERNEL_TARGET_AVX512 inline void DivideSqrtAvx512(float *data, float divisor, ::size_t sz)
+{
+	const __m512 DIVISOR = _mm512_set1_ps(divisor);
+	::size_t n = 0;
+	for (; n + 16 <= sz; n += 16)
+		_mm512_storeu_ps(data + n, _mm512_sqrt_ps(_mm512_div_ps(_mm512_loadu_ps(data + n), DIVISOR)));
+	DivideSqrtScalar(data + n, divisor, sz - n);
+}
+
+KERNEL_TARGET_AVX512 inline ::size_t MarkAvx512(const float *data, const float *mean, const float *std, float th, unsigned char *dst, ::size_t sz)
+{
+	const __m512 TH = _mm512_set1_ps(th);
+	const __m512i ALL_ONES = _mm512_set1_epi32(-1);
+	::size_t count(0), n(0);
+	for (; n + 16 <= sz; n += 16)
+	{
+		__m512 diff = _mm512_abs_ps(_mm512_sub_ps(_mm512_loadu_ps(data + n), _mm512_loadu_ps(mean + n)));
+		__mmask16 marked = _mm512_cmp_ps_mask(_mm512_div_ps(diff, _mm512_loadu_ps(std + n)), TH, _CMP_GT_OQ);
+		// Truncating -1 to a byte gives 0xFF.
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + n), _mm512_cvtepi32_epi8(_mm512_maskz_mov_epi32(marked, ALL_ONES)));
+		count += CountMaskBits(static_cast<unsigned int>(marked));
+	}
+	return count + MarkScalar(data + n, mean + n, std + n, th, dst + n, sz - n);
+}
+#endif
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Registry.
+
+// Kernels for a given level. Levels without a dedicated routine reuse the next lower one
+// (GrayToBgr is a byte shuffle, which AVX2/AVX-512 don't speed up beyond SSE4.1).
+inline const PixelKernels &GetPixelKernels(CpuLevel level)
+{
+	static const PixelKernels SCALAR = { L"Scalar", BgraToGrayScalar, AccumulateScalar, AccumulateDiffSqScalar,
+		DivideScalar, DivideSqrtScalar, MarkScalar, GrayToBgrScalar };
+	static const PixelKernels SSE41 = { L"SSE4.1", BgraToGraySse41, AccumulateSse41, AccumulateDiffSqSse41,
+		DivideSse41, DivideSqrtSse41, MarkSse41, GrayToBgrSse41 };
+	static const PixelKernels AVX2 = { L"AVX2", BgraToGrayAvx2, AccumulateAvx2, AccumulateDiffSqAvx2,
+		DivideAvx2, DivideSqrtAvx2, MarkAvx2, GrayToBgrSse41 };
+#if defined(PIXEL_KERNELS_AVX512)
+	static const PixelKernels AVX512 = { L"AVX-512", BgraToGrayAvx512, AccumulateAvx512, AccumulateDiffSqAvx512,
+		DivideAvx512, DivideSqrtAvx512, MarkAvx512, GrayToBgrSse41 };
+#endif
+	switch (level)
+	{
+	case CpuLevel::Sse41: return SSE41;
+	case CpuLevel::Avx2: return AVX2;
+#if defined(PIXEL_KERNELS_AVX512)
+	case CpuLevel::Avx512: return AVX512;
+#else
+	case CpuLevel::Avx512: return AVX2;
+#endif
+	default: return SCALAR;
+	}
+}
+
+// Kernels for the CPU we are running on, selected once by CPUID.
+inline const PixelKernels &SelectPixelKernels(void)
+{
+	static const PixelKernels &SELECTED = GetPixelKernels(DetectCpuLevel());
+	return SELECTED;
+}
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC pop_options
+#endif
+
+#endif
@@ -0,0 +1,41 @@
+#if !defined(PRECISION_CLOCK_H)
+#define PRECISION_CLOCK_H
+
+// Standard C++ header files.
+#include <chrono>
+#include <ratio>
+
+#if defined(_WIN32)
+// Windows header files.
+#include <Windows.h>
+#endif
+
+// Clock for timing work of a few microseconds to a few milliseconds.
+// In Visual C++ 2013, std::chrono::high_resolution_clock and steady_clock are both the system clock, which ticks
+// every 1 to 15.6 ms; a kernel timed with them measures 0 or one tick. QueryPerformanceCounter() resolves well below
+// a microsecond and is monotonic. Elsewhere steady_clock already does that.
+#if defined(_WIN32)
+struct PrecisionClock
+{
+	typedef long long rep;
+	typedef std::nano period;
+	typedef std::chrono::duration<rep, period> duration;
+	typedef std::chrono::time_point<PrecisionClock> time_point;
+	static const bool is_steady = true;
+
+	static time_point now(void)
+	{
+		::LARGE_INTEGER counter, frequency;
+		::QueryPerformanceCounter(&counter);
+		::QueryPerformanceFrequency(&frequency);
+		// Whole seconds and the remainder separately, so that counter * 10^9 can't overflow.
+		const long long seconds = counter.QuadPart / frequency.QuadPart;
+		const long long remainder = counter.QuadPart % frequency.QuadPart;
+		return time_point(duration(seconds * 1000000000LL + remainder * 1000000000LL / frequency.QuadPart));
+	}
+};
+#else
+typedef std::chrono::steady_clock PrecisionClock;
+#endif
+
+#endif
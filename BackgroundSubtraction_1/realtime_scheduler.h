@@ -0,0 +1,181 @@
+#if !defined(REALTIME_SCHEDULER_H)
+#define REALTIME_SCHEDULER_H
+
+// Standard C++ header files.
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <algorithm>
+
+// Custom header files.
+#include "precision_clock.h"
+
+// Arrival times and latencies are a few milliseconds apart, below the tick of the system clock.
+typedef PrecisionClock RealTimeClock;
+
+// A frame from a live source, stamped when it arrived.
+struct TimedFrame
+{
+	std::vector<float> Data;
+	::size_t Index = 0;
+	RealTimeClock::time_point Arrival;
+};
+
+// Queue between a live source and the processing thread.
+class FrameQueue
+{
+public:
+	void Push(TimedFrame &&frame)
+	{
+		{
+			std::lock_guard<std::mutex> lock(this->Mutex);
+			this->Frames.push_back(std::move(frame));
+		}
+		this->Ready.notify_one();
+	}
+
+	// Wait for a frame. Returns false once the source is closed and the queue is empty.
+	bool Pop(TimedFrame &frame)
+	{
+		std::unique_lock<std::mutex> lock(this->Mutex);
+		this->Ready.wait(lock, [this]() { return !this->Frames.empty() || this->Closed; });
+		if (this->Frames.empty())
+			return false;
+		frame = std::move(this->Frames.front());
+		this->Frames.pop_front();
+		return true;
+	}
+
+	// Drop every queued frame except the newest one. Returns the number dropped.
+	::size_t DropAllButNewest(void)
+	{
+		std::lock_guard<std::mutex> lock(this->Mutex);
+		::size_t num_dropped = this->Frames.size() > 1 ? this->Frames.size() - 1 : 0;
+		if (num_dropped != 0)
+			this->Frames.erase(this->Frames.begin(), this->Frames.end() - 1);
+		return num_dropped;
+	}
+
+	// Number of queued frames.
+	::size_t Size(void)
+	{
+		std::lock_guard<std::mutex> lock(this->Mutex);
+		return this->Frames.size();
+	}
+
+	void Close(void)
+	{
+		{
+			std::lock_guard<std::mutex> lock(this->Mutex);
+			this->Closed = true;
+		}
+		this->Ready.notify_all();
+	}
+
+protected:
+	std::mutex Mutex;
+	std::condition_variable Ready;
+	std::deque<TimedFrame> Frames;
+	bool Closed = false;
+};
+
+// Load shedding stages, from cheapest to most drastic.
+enum class ShedStage
+{
+	None,				// Update the model with every frame.
+	SkipModelUpdate,	// Classify against the last model without adding the frame to it.
+	ReducedResolution,	// As above, but classify at half resolution in each direction.
+	DropFrames			// Skip every queued frame but the newest.
+};
+
+inline const wchar_t *ShedStageName(ShedStage stage)
+{
+	switch (stage)
+	{
+	case ShedStage::SkipModelUpdate: return L"skip_update";
+	case ShedStage::ReducedResolution: return L"half_resolution";
+	case ShedStage::DropFrames: return L"drop";
+	default: return L"full";
+	}
+}
+
+// Everything the real-time mode decided, for capacity planning.
+struct RealTimeMetrics
+{
+	RealTimeMetrics(void) : NumProcessed() {}
+
+	::size_t NumArrived = 0;
+	::size_t NumProcessed[4];			// Frames processed at each ShedStage.
+	::size_t NumDropped = 0;			// Frames never processed.
+	::size_t NumStageChanges = 0;
+	double MaxLatency = 0.0, SumLatency = 0.0;	// Arrival to mask, in seconds.
+	::size_t NumOverBudget = 0;					// Processed frames whose latency exceeded the budget.
+};
+
+// Chooses a ShedStage from the age of the oldest queued frame relative to the latency budget.
+// Each stage is entered at a fixed fraction of the budget and left only when the age falls below half of it,
+// so the stage doesn't flip on every frame when the load sits near a boundary.
+class LoadShedder
+{
+public:
+	LoadShedder(double latencyBudget) : Budget(latencyBudget) {}
+
+	ShedStage Decide(double oldestAge)
+	{
+		// Fractions of the budget at which stages 1, 2 and 3 are entered.
+		const double ENTER[4] = { 0.0, 0.5, 1.0, 2.0 };
+		const double EXIT_FACTOR(0.5);
+		const double ratio = this->Budget > 0.0 ? oldestAge / this->Budget : 0.0;
+
+		int target(0);
+		for (int stage = 1; stage != 4; ++stage)
+			if (ratio >= ENTER[stage])
+				target = stage;
+		int current = static_cast<int>(this->Stage);
+		if (target > current || ratio < EXIT_FACTOR * ENTER[current])
+			current = target;
+		if (current != static_cast<int>(this->Stage))
+			++this->NumChanges;
+		this->Stage = static_cast<ShedStage>(current);
+		return this->Stage;
+	}
+
+	ShedStage Current(void) const { return this->Stage; }
+	::size_t NumStageChanges(void) const { return this->NumChanges; }
+	double LatencyBudget(void) const { return this->Budget; }
+
+protected:
+	double Budget;
+	ShedStage Stage = ShedStage::None;
+	::size_t NumChanges = 0;
+};
+
+// Average 2x2 blocks; odd last rows/columns are dropped.
+inline void DownsampleHalf(const float *src, ::size_t width, ::size_t height, std::vector<float> &dst)
+{
+	const ::size_t w = width / 2, h = height / 2;
+	dst.resize(w * h);
+	for (::size_t y = 0; y != h; ++y)
+	{
+		const float *row0 = src + 2 * y * width, *row1 = row0 + width;
+		for (::size_t x = 0; x != w; ++x)
+			dst[y * w + x] = (row0[2 * x] + row0[2 * x + 1] + row1[2 * x] + row1[2 * x + 1]) * 0.25f;
+	}
+}
+
+// Nearest-neighbor upsampling of a half-resolution mask back to width x height.
+inline void UpsampleHalf(const std::vector<unsigned char> &src, ::size_t width, ::size_t height, std::vector<unsigned char> &dst)
+{
+	const ::size_t w = width / 2, h = height / 2;
+	dst.resize(width * height);
+	for (::size_t y = 0; y != height; ++y)
+	{
+		const unsigned char *row = src.data() + std::min(y / 2, h - 1) * w;
+		for (::size_t x = 0; x != width; ++x)
+			dst[y * width + x] = row[std::min(x / 2, w - 1)];
+	}
+}
+
+#endif
@@ -0,0 +1,294 @@
+#if !defined(SHARED_FRAME_RING_H)
+#define SHARED_FRAME_RING_H
+
+// Standard C header files.
+#include <cstring>
+#include <cstdlib>
+
+// Standard C++ header files.
+#include <string>
+#include <vector>
+#include <iostream>
+#include <atomic>
+#include <new>
+
+#if defined(_WIN32)
+// Windows header files.
+#include <Windows.h>
+#else
+// POSIX header files.
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// Ring of the latest frames in named shared memory, for consumer processes on the same machine.
+// Every slot holds the 8bit gray image, the mask and the metadata of one frame. The engine publishes into the slot
+// after the newest one and then advances LatestSequence, so consumers read the newest frame in place, without a copy
+// or a system call. Each slot is guarded by a sequence lock: its Sequence is odd while the slot is being written and
+// advances by 2 on every write. A consumer reads Sequence, uses the slot, and checks that Sequence didn't change;
+// otherwise the producer has lapped it and the data must be discarded. With NumSlots slots, that only happens if a
+// consumer holds on to a frame for longer than NumSlots - 1 frame periods.
+// Named file mappings on Windows, shm_open() elsewhere. Only 32bit atomics are used, which are plain loads on
+// every supported platform, so consumers can map the ring read-only.
+const unsigned int SHARED_FRAME_RING_VERSION = 1;
+const char SHARED_FRAME_RING_MAGIC[8] = { 'B', 'G', 'S', 'R', 'I', 'N', 'G', '\0' };
+const ::size_t SHARED_FRAME_RING_ALIGNMENT = 64;	// Slots start on their own cache lines.
+
+struct SharedRingHeader
+{
+	char Magic[8];
+	unsigned int Version;
+	unsigned int NumSlots;
+	unsigned long long MaxWidth, MaxHeight;
+	unsigned long long SlotSize;			// Bytes from one slot to the next.
+	std::atomic<unsigned int> LatestSequence;	// Number of frames published; the newest is in slot (LatestSequence - 1) % NumSlots.
+};
+
+struct SharedSlotHeader
+{
+	std::atomic<unsigned int> Sequence;		// Odd while the slot is being written.
+	unsigned int PublishSequence;			// Value of LatestSequence which published this slot.
+	unsigned long long FrameIndex;			// Position of the frame in the input.
+	unsigned long long Width, Height;
+	unsigned long long NumForeground;
+	// Followed by Width * Height gray values and Width * Height mask values at SHARED_FRAME_RING_ALIGNMENT.
+};
+
+// A frame read in place from a SharedFrameRing. Valid until SharedFrameRing::IsValid() returns false.
+struct SharedFrameView
+{
+	unsigned int Sequence = 0;				// Slot sequence when the view was taken.
+	unsigned int PublishSequence = 0;
+	unsigned long long FrameIndex = 0;
+	::size_t Width = 0, Height = 0, NumForeground = 0;
+	const unsigned char *Gray = nullptr;
+	const unsigned char *Mask = nullptr;
+	const SharedSlotHeader *Slot = nullptr;
+};
+
+class SharedFrameRing
+{
+public:
+	SharedFrameRing(void) = default;
+	SharedFrameRing(const SharedFrameRing &) = delete;
+	SharedFrameRing &operator=(const SharedFrameRing &) = delete;
+	~SharedFrameRing(void) { this->Close(); }
+
+	// Producer: create a ring for frames up to maxWidth x maxHeight. On POSIX a previous ring of the same name is
+	// unlinked, and its consumers keep the old memory. On Windows the name exists as long as any process has it open,
+	// with the size it was created with, so Create() fails while an earlier producer or its consumers are running.
+	bool Create(const std::wstring &name, ::size_t maxWidth, ::size_t maxHeight, ::size_t numSlots = 8);
+	// Consumer: map an existing ring read-only.
+	bool Open(const std::wstring &name);
+	void Close(void);
+	bool IsOpen(void) const { return this->Header != nullptr; }
+
+	// Write a frame into the next slot. Returns false if the ring is not created or the frame is larger than it.
+	bool Publish(unsigned long long frameIndex, const float *gray, const unsigned char *mask, ::size_t width, ::size_t height,
+		::size_t numForeground);
+
+	// Number of frames published so far.
+	unsigned int LatestSequence(void) const { return this->Header->LatestSequence.load(std::memory_order_acquire); }
+	// View of the newest frame. Returns false if nothing has been published yet or the slot is being written.
+	bool Latest(SharedFrameView &view) const;
+	// True if the slot of the view hasn't been written since the view was taken. Call after reading the data.
+	bool IsValid(const SharedFrameView &view) const
+	{
+		std::atomic_thread_fence(std::memory_order_acquire);
+		return view.Slot->Sequence.load(std::memory_order_relaxed) == view.Sequence;
+	}
+
+protected:
+	SharedSlotHeader *SlotAt(unsigned int n) const
+	{
+		return reinterpret_cast<SharedSlotHeader *>(reinterpret_cast<unsigned char *>(this->Header) +
+			RoundUp(sizeof(SharedRingHeader)) + n * this->Header->SlotSize);
+	}
+	static ::size_t RoundUp(::size_t sz) { return (sz + SHARED_FRAME_RING_ALIGNMENT - 1) / SHARED_FRAME_RING_ALIGNMENT * SHARED_FRAME_RING_ALIGNMENT; }
+	bool Map(const std::wstring &name, ::size_t sz, bool create);
+
+	SharedRingHeader *Header = nullptr;
+	::size_t MappedSize = 0;
+	bool Owner = false;
+	std::string PosixName;
+#if defined(_WIN32)
+	HANDLE Mapping = nullptr;
+#endif
+};
+
+// Map 'sz' bytes of the named shared memory, creating it if 'create' is set. sz is ignored when opening.
+inline bool SharedFrameRing::Map(const std::wstring &name, ::size_t sz, bool create)
+{
+#if defined(_WIN32)
+	std::wstring name_local = L"Local\\" + name;
+	if (create)
+		this->Mapping = ::CreateFileMappingW(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE,
+			static_cast<DWORD>(static_cast<unsigned long long>(sz) >> 32), static_cast<DWORD>(sz), name_local.c_str());
+	else
+		this->Mapping = ::OpenFileMappingW(FILE_MAP_READ, FALSE, name_local.c_str());
+	if (this->Mapping == nullptr)
+		return false;
+	// An existing section is returned as it is, possibly smaller and with consumers reading it; don't overwrite it.
+	if (create && ::GetLastError() == ERROR_ALREADY_EXISTS)
+	{
+		std::wclog << L"Shared memory " << name_local << L" is still open in another process." << std::endl;
+		::CloseHandle(this->Mapping);
+		this->Mapping = nullptr;
+		return false;
+	}
+	void *view = ::MapViewOfFile(this->Mapping, create ? FILE_MAP_ALL_ACCESS : FILE_MAP_READ, 0, 0, create ? sz : 0);
+	if (view == nullptr)
+	{
+		::CloseHandle(this->Mapping);
+		this->Mapping = nullptr;
+		return false;
+	}
+	this->Header = static_cast<SharedRingHeader *>(view);
+	this->MappedSize = sz;
+	return true;
+#else
+	std::vector<char> narrow(name.size() * MB_CUR_MAX + 2);
+	narrow[0] = '/';
+	if (std::wcstombs(narrow.data() + 1, name.c_str(), narrow.size() - 1) == static_cast<::size_t>(-1))
+		return false;
+	this->PosixName = narrow.data();
+	if (create)
+		::shm_unlink(this->PosixName.c_str());
+	int fd = ::shm_open(this->PosixName.c_str(), create ? O_CREAT | O_RDWR : O_RDONLY, 0644);
+	if (fd < 0)
+		return false;
+	struct stat st;
+	if (create ? ::ftruncate(fd, static_cast<off_t>(sz)) != 0 : ::fstat(fd, &st) != 0)
+	{
+		::close(fd);
+		return false;
+	}
+	if (!create)
+		sz = static_cast<::size_t>(st.st_size);
+	void *view = sz < sizeof(SharedRingHeader) ? MAP_FAILED :
+		::mmap(nullptr, sz, create ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0);
+	::close(fd);
+	if (view == MAP_FAILED)
+		return false;
+	this->Header = static_cast<SharedRingHeader *>(view);
+	this->MappedSize = sz;
+	return true;
+#endif
+}
+
+inline bool SharedFrameRing::Create(const std::wstring &name, ::size_t maxWidth, ::size_t maxHeight, ::size_t numSlots)
+{
+	this->Close();
+	const ::size_t sz_slot = RoundUp(sizeof(SharedSlotHeader)) + 2 * RoundUp(maxWidth * maxHeight);
+	if (numSlots < 2 || !this->Map(name, RoundUp(sizeof(SharedRingHeader)) + numSlots * sz_slot, true))
+		return false;
+	this->Owner = true;
+
+	// Consumers check the magic last, so they never see a half-initialized header.
+	SharedRingHeader *header = this->Header;
+	std::memset(header->Magic, 0, sizeof(header->Magic));
+	header->Version = SHARED_FRAME_RING_VERSION;
+	header->NumSlots = static_cast<unsigned int>(numSlots);
+	header->MaxWidth = maxWidth;
+	header->MaxHeight = maxHeight;
+	header->SlotSize = sz_slot;
+	new (&header->LatestSequence) std::atomic<unsigned int>(0);
+	for (unsigned int n = 0; n != header->NumSlots; ++n)
+	{
+		SharedSlotHeader *slot = this->SlotAt(n);
+		new (&slot->Sequence) std::atomic<unsigned int>(0);
+		slot->PublishSequence = 0;
+		slot->FrameIndex = slot->Width = slot->Height = slot->NumForeground = 0;
+	}
+	std::atomic_thread_fence(std::memory_order_release);
+	std::memcpy(header->Magic, SHARED_FRAME_RING_MAGIC, sizeof(header->Magic));
+	return true;
+}
+
+inline bool SharedFrameRing::Open(const std::wstring &name)
+{
+	this->Close();
+	if (!this->Map(name, 0, false))
+		return false;
+	const SharedRingHeader *header = this->Header;
+	if (std::memcmp(header->Magic, SHARED_FRAME_RING_MAGIC, sizeof(header->Magic)) != 0 || header->Version != SHARED_FRAME_RING_VERSION)
+	{
+		this->Close();
+		return false;
+	}
+	std::atomic_thread_fence(std::memory_order_acquire);
+	return true;
+}
+
+inline void SharedFrameRing::Close(void)
+{
+	if (this->Header == nullptr)
+		return;
+#if defined(_WIN32)
+	// The mapping disappears with its last handle.
+	::UnmapViewOfFile(this->Header);
+	::CloseHandle(this->Mapping);
+	this->Mapping = nullptr;
+#else
+	::munmap(this->Header, this->MappedSize);
+	if (this->Owner)
+		::shm_unlink(this->PosixName.c_str());
+#endif
+	this->Header = nullptr;
+	this->MappedSize = 0;
+	this->Owner = false;
+}
+
+inline bool SharedFrameRing::Publish(unsigned long long frameIndex, const float *gray, const unsigned char *mask,
+	::size_t width, ::size_t height, ::size_t numForeground)
+{
+	if (this->Header == nullptr || !this->Owner || width * height > this->Header->MaxWidth * this->Header->MaxHeight)
+		return false;
+
+	const unsigned int publish_sequence = this->Header->LatestSequence.load(std::memory_order_relaxed) + 1;
+	SharedSlotHeader *slot = this->SlotAt((publish_sequence - 1) % this->Header->NumSlots);
+	const unsigned int sequence = slot->Sequence.load(std::memory_order_relaxed);
+	slot->Sequence.store(sequence + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	slot->PublishSequence = publish_sequence;
+	slot->FrameIndex = frameIndex;
+	slot->Width = width;
+	slot->Height = height;
+	slot->NumForeground = numForeground;
+	unsigned char *dst_gray = reinterpret_cast<unsigned char *>(slot) + RoundUp(sizeof(SharedSlotHeader));
+	unsigned char *dst_mask = dst_gray + RoundUp(this->Header->MaxWidth * this->Header->MaxHeight);
+	const ::size_t sz = width * height;
+	for (::size_t n = 0; n != sz; ++n)
+		dst_gray[n] = static_cast<unsigned char>(gray[n]);
+	std::memcpy(dst_mask, mask, sz);
+
+	slot->Sequence.store(sequence + 2, std::memory_order_release);
+	this->Header->LatestSequence.store(publish_sequence, std::memory_order_release);
+	return true;
+}
+
+inline bool SharedFrameRing::Latest(SharedFrameView &view) const
+{
+	const unsigned int publish_sequence = this->LatestSequence();
+	if (publish_sequence == 0)
+		return false;
+	const SharedSlotHeader *slot = this->SlotAt((publish_sequence - 1) % this->Header->NumSlots);
+	view.Sequence = slot->Sequence.load(std::memory_order_acquire);
+	if (view.Sequence & 1)
+		return false;
+	view.PublishSequence = slot->PublishSequence;
+	view.FrameIndex = slot->FrameIndex;
+	view.Width = static_cast<::size_t>(slot->Width);
+	view.Height = static_cast<::size_t>(slot->Height);
+	view.NumForeground = static_cast<::size_t>(slot->NumForeground);
+	view.Gray = reinterpret_cast<const unsigned char *>(slot) + RoundUp(sizeof(SharedSlotHeader));
+	view.Mask = view.Gray + RoundUp(this->Header->MaxWidth * this->Header->MaxHeight);
+	view.Slot = slot;
+	// The metadata must not have changed while it was read either.
+	return this->IsValid(view);
+}
+
+#endif
@@ -0,0 +1,123 @@
+#if !defined(SYNTHETIC_SEQUENCE_H)
+#define SYNTHETIC_SEQUENCE_H
+
+// Standard C++ header files.
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+// Parameters of a SyntheticSequence.
+struct SyntheticConfig
+{
+	::size_t Width = 320, Height = 240;
+	unsigned int Seed = 1;
+	float NoiseAmplitude = 4.0f;		// Uniform sensor noise in [-NoiseAmplitude, NoiseAmplitude].
+	::size_t NumShapes = 3;				// Moving rectangles.
+	float ShapeSize = 0.15f;			// Side of a shape relative to the shorter image side.
+	float ShapeSpeed = 0.01f;			// Displacement per frame relative to the image size.
+	float IlluminationRamp = 0.002f;	// Global gain change per frame; the gain oscillates between 0.75 and 1.25.
+};
+
+// Deterministic generator of test sequences for validating kernels without any image files.
+// A static textured background with sensor noise, moving rectangles that bounce off the borders and a slow
+// illumination ramp. Values are rounded and clamped to [0, 255], like frames decoded from 8bit images.
+// The random number generator is a fixed xorshift, so the same config gives the same frames on every compiler
+// and platform.
+class SyntheticSequence
+{
+public:
+	SyntheticSequence(const SyntheticConfig &config);
+
+	// Generate the next gray frame.
+	void Next(std::vector<float> &gray);
+	// Number of frames generated so far.
+	::size_t FrameIndex(void) const { return this->Index; }
+	const SyntheticConfig &Config(void) const { return this->Settings; }
+
+protected:
+	// xorshift32; never returns 0 for a non-zero state.
+	unsigned int Random(void)
+	{
+		this->State ^= this->State << 13;
+		this->State ^= this->State >> 17;
+		this->State ^= this->State << 5;
+		return this->State;
+	}
+	// Uniform in [0, 1).
+	float RandomUnit(void) { return (this->Random() >> 8) * (1.0f / 16777216.0f); }
+
+	struct Shape
+	{
+		float X, Y, VX, VY;	// Top-left corner and velocity in pixels.
+		float Value;
+	};
+
+	SyntheticConfig Settings;
+	unsigned int State;
+	::size_t Index = 0;
+	std::vector<float> Background;
+	std::vector<Shape> Shapes;
+	float ShapeSide;
+};
+
+inline SyntheticSequence::SyntheticSequence(const SyntheticConfig &config) : Settings(config),
+	State(config.Seed == 0 ? 0x9E3779B9u : config.Seed)
+{
+	const ::size_t W = config.Width, H = config.Height;
+
+	// Smooth gradient plus a fixed texture, so every pixel has its own mean.
+	this->Background.resize(W * H);
+	for (::size_t y = 0; y != H; ++y)
+		for (::size_t x = 0; x != W; ++x)
+			this->Background[y * W + x] = 60.0f + 80.0f * x / std::max<::size_t>(1, W) + 40.0f * y / std::max<::size_t>(1, H)
+				+ 20.0f * this->RandomUnit();
+
+	this->ShapeSide = std::max(1.0f, config.ShapeSize * std::min(W, H));
+	for (::size_t n = 0; n != config.NumShapes; ++n)
+	{
+		Shape shape;
+		shape.X = this->RandomUnit() * std::max(0.0f, W - this->ShapeSide);
+		shape.Y = this->RandomUnit() * std::max(0.0f, H - this->ShapeSide);
+		shape.VX = (this->RandomUnit() * 2.0f - 1.0f) * config.ShapeSpeed * W;
+		shape.VY = (this->RandomUnit() * 2.0f - 1.0f) * config.ShapeSpeed * H;
+		shape.Value = this->RandomUnit() < 0.5f ? 20.0f : 235.0f;
+		this->Shapes.push_back(shape);
+	}
+}
+
+inline void SyntheticSequence::Next(std::vector<float> &gray)
+{
+	const ::size_t W = this->Settings.Width, H = this->Settings.Height;
+	gray.resize(W * H);
+
+	// Triangle wave between 0.75 and 1.25 so long sequences don't saturate.
+	float phase = std::fmod(this->Settings.IlluminationRamp * this->Index, 1.0f);
+	float gain = 0.75f + (phase < 0.5f ? phase : 1.0f - phase);
+
+	const float noise = this->Settings.NoiseAmplitude;
+	for (::size_t n = 0; n != W * H; ++n)
+	{
+		float value = this->Background[n] * gain + (this->RandomUnit() * 2.0f - 1.0f) * noise;
+		gray[n] = std::floor(std::min(255.0f, std::max(0.0f, value)) + 0.5f);
+	}
+
+	// Draw the shapes, then move them for the next frame.
+	for (auto &shape : this->Shapes)
+	{
+		::size_t x0 = static_cast<::size_t>(std::max(0.0f, shape.X)), y0 = static_cast<::size_t>(std::max(0.0f, shape.Y));
+		::size_t x1 = std::min(W, static_cast<::size_t>(shape.X + this->ShapeSide));
+		::size_t y1 = std::min(H, static_cast<::size_t>(shape.Y + this->ShapeSide));
+		for (::size_t y = y0; y < y1; ++y)
+			std::fill(gray.begin() + y * W + x0, gray.begin() + y * W + std::max(x0, x1), shape.Value);
+
+		shape.X += shape.VX;
+		shape.Y += shape.VY;
+		if (shape.X < 0.0f || shape.X + this->ShapeSide > W)
+			shape.VX = -shape.VX;
+		if (shape.Y < 0.0f || shape.Y + this->ShapeSide > H)
+			shape.VY = -shape.VY;
+	}
+	++this->Index;
+}
+
+#endif